@@ -9,33 +9,66 @@ CONFIG += c++11
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    batchfollower.cpp \
     batchtab.cpp \
     datastructures.cpp \
+    datreader.cpp \
+    datscanner.cpp \
     dattablemodel.cpp \
+    gzipreader.cpp \
+    importjob.cpp \
+    lineindex.cpp \
     main.cpp \
     mainwindow.cpp \
+    numparse.cpp \
+    packedpoints.cpp \
     plotwidget.cpp \
+    pointbitset.cpp \
+    pointcache.cpp \
+    pointpyramid.cpp \
+    pointstore.cpp \
     previewdialog.cpp \
     projectmanager.cpp \
     projectmodel.cpp \
     projecttreeview.cpp \
-    tablemodel.cpp
+    spatialgrid.cpp \
+    tablemodel.cpp \
+    tilerenderer.cpp \
+    zonemap.cpp
 
 HEADERS += \
+    batchfollower.h \
     batchtab.h \
     datastructures.h \
+    datreader.h \
+    datscanner.h \
     dattablemodel.h \
+    gzipreader.h \
+    importjob.h \
+    lineindex.h \
     mainwindow.h \
+    numparse.h \
+    packedpoints.h \
     plotwidget.h \
+    pointbitset.h \
+    pointcache.h \
+    pointpyramid.h \
+    pointstore.h \
     previewdialog.h \
     projectmanager.h \
     projectmodel.h \
     projecttreeview.h \
-    tablemodel.h
+    spatialgrid.h \
+    tablemodel.h \
+    tilerenderer.h \
+    zonemap.h
 
 FORMS += \
     mainwindow.ui
 
+# gzip解压：Windows下使用Qt自带的zlib，其他平台链接系统zlib
+unix: LIBS += -lz
+
 # Default rules for deployment.
 qnx: target.path = /tmp/$${TARGET}/bin
 else: unix:!android: target.path = /opt/$${TARGET}/bin
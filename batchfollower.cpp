@@ -0,0 +1,147 @@
+#include "batchfollower.h"
+#include <QDebug>
+#include <QFile>
+#include <QFileSystemWatcher>
+#include <QTimer>
+
+namespace {
+
+// 网络共享上的文件变化通知不可靠，同时定时检查
+const int PollIntervalMs = 1000;
+
+// 每次最多读取这么多字节，积压较多时分多次读完，避免界面卡顿
+const qint64 MaxReadBytes = 16 * 1024 * 1024;
+
+}
+
+BatchFollower::BatchFollower(const QString& filePath, const ColumnMapping& mapping, QObject *parent)
+    : QObject(parent)
+    , m_filePath(filePath)
+    , m_mapping(mapping)
+    , m_offset(-1)
+    , m_skipRows(0)
+    , m_watcher(new QFileSystemWatcher(this))
+    , m_pollTimer(new QTimer(this))
+{
+    m_pollTimer->setInterval(PollIntervalMs);
+    connect(m_pollTimer, &QTimer::timeout, this, &BatchFollower::poll);
+    connect(m_watcher, &QFileSystemWatcher::fileChanged, this, &BatchFollower::poll);
+}
+
+int BatchFollower::start(qint64 parsedEnd, int parsedRows)
+{
+    int pendingRows = 0;
+    m_offset = -1;
+    m_skipRows = 0;
+
+    MappedDatFile datFile(m_filePath);
+    if (parsedEnd >= 0 && datFile.open() && datFile.hasBody() && parsedEnd >= datFile.bodyOffset()) {
+        m_plan = DatParsePlan::build(datFile, m_mapping);
+        m_offset = parsedEnd;
+
+        // 文件只会在末尾追加，parsedEnd之前的内容与读入时相同；
+        // 文件已变小时不必回找，由poll()停止跟踪
+        if (parsedEnd <= datFile.size()) {
+            const char *begin = datFile.bodyBegin();
+            const char *end = datFile.data() + parsedEnd;
+            const char *tail = end;
+            while (tail > begin && tail[-1] != '\n')
+                --tail;
+            if (tail < end) {
+                PointStore partial;
+                pendingRows = DatReader::parseRows(tail, end, m_plan, partial);
+                m_offset = tail - datFile.data();
+            }
+        }
+    } else {
+        // 不知道读到了哪里（如旧项目），按点数跳过已读入的数据行
+        m_skipRows = parsedRows;
+    }
+
+    m_watcher->addPath(m_filePath);
+    m_pollTimer->start();
+    return pendingRows;
+}
+
+void BatchFollower::stop()
+{
+    m_pollTimer->stop();
+    if (!m_watcher->files().isEmpty())
+        m_watcher->removePaths(m_watcher->files());
+}
+
+bool BatchFollower::isFollowing() const
+{
+    return m_pollTimer->isActive();
+}
+
+bool BatchFollower::initPlan()
+{
+    MappedDatFile datFile(m_filePath);
+    if (!datFile.open() || !datFile.hasBody())
+        return false;
+
+    m_plan = DatParsePlan::build(datFile, m_mapping);
+    m_offset = datFile.bodyOffset();
+    return true;
+}
+
+void BatchFollower::poll()
+{
+    if (!isFollowing())
+        return;
+
+    // 开始跟踪时表头还没写出来
+    if (m_offset < 0 && !initPlan())
+        return;
+
+    QFile file(m_filePath);
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+
+    const qint64 size = file.size();
+    if (size < m_offset) {
+        stop();
+        qWarning() << "跟踪的文件变小了:" << m_filePath;
+        emit followingStopped(QString("文件 [%1] 被截断或替换").arg(m_filePath));
+        return;
+    }
+    if (size == m_offset || !file.seek(m_offset))
+        return;
+
+    // 只解析到最后一个换行符为止，未写完的行留到下次
+    const QByteArray chunk = file.read(qMin(size - m_offset, MaxReadBytes));
+    const int complete = chunk.lastIndexOf('\n') + 1;
+    if (complete == 0) {
+        // 读满一次仍没有换行符，不是正常的数据行，再等也读不下去
+        if (chunk.size() == MaxReadBytes) {
+            stop();
+            qWarning() << "跟踪的文件中有过长的行:" << m_filePath << m_offset;
+            emit followingStopped(QString("文件 [%1] 中有超过 %2 MB 的行，无法继续跟踪")
+                                  .arg(m_filePath).arg(MaxReadBytes / (1024 * 1024)));
+        }
+        return;
+    }
+
+    PointStore points;
+    DatReader::parseRows(chunk.constData(), chunk.constData() + complete, m_plan, points);
+    m_offset += complete;
+
+    // 已在架次中的数据行不再追加
+    if (m_skipRows > 0) {
+        const int skipped = qMin(m_skipRows, points.size());
+        m_skipRows -= skipped;
+        points = skipped < points.size() ? points.mid(skipped) : PointStore();
+    }
+
+    // 文件被重新创建后监视会失效，重新添加
+    if (m_watcher->files().isEmpty())
+        m_watcher->addPath(m_filePath);
+
+    if (!points.isEmpty())
+        emit pointsAppended(points);
+
+    // 本次只读了一部分积压数据，稍后继续
+    if (chunk.size() == MaxReadBytes)
+        QTimer::singleShot(0, this, &BatchFollower::poll);
+}
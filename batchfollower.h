@@ -0,0 +1,54 @@
+#ifndef BATCHFOLLOWER_H
+#define BATCHFOLLOWER_H
+
+#include <QObject>
+#include <QList>
+#include <QString>
+#include "datastructures.h"
+#include "datreader.h"
+
+class QFileSystemWatcher;
+class QTimer;
+
+// 跟踪仍在写入的DAT文件：文件增长后只解析新追加的完整行
+// 最后一行还没写完（没有换行符）时留到下次再读
+class BatchFollower : public QObject
+{
+    Q_OBJECT
+
+public:
+    BatchFollower(const QString& filePath, const ColumnMapping& mapping, QObject *parent = nullptr);
+
+    // 从导入（或上次跟踪）读到的位置parsedEnd继续跟踪，读到该处之前的点已有parsedRows个
+    // 该处不在行首时，最后一行读入时还没写完，返回由它解析出的点数，调用方应先移除这些点，
+    // 从该行行首重新读入；parsedEnd未知（-1）时从数据区开头读，跳过前parsedRows个数据行
+    int start(qint64 parsedEnd, int parsedRows);
+    void stop();
+    bool isFollowing() const;
+
+    QString filePath() const { return m_filePath; }
+    // 已读入到的字节偏移，-1表示尚未确定
+    qint64 parsedEnd() const { return m_skipRows > 0 ? -1 : m_offset; }
+
+signals:
+    // 新追加的完整行解析出的点
+    void pointsAppended(const PointStore& points);
+    // 文件被截断或替换，跟踪已停止
+    void followingStopped(const QString& reason);
+
+private slots:
+    void poll();
+
+private:
+    bool initPlan();
+
+    QString m_filePath;
+    ColumnMapping m_mapping;
+    DatParsePlan m_plan;
+    qint64 m_offset;        // 下一次读取的起点，-1表示尚未找到表头
+    int m_skipRows;         // 已在架次中、读到时须跳过的数据行数
+    QFileSystemWatcher *m_watcher;
+    QTimer *m_pollTimer;
+};
+
+#endif // BATCHFOLLOWER_H
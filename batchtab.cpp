@@ -1,5 +1,6 @@
 #include "batchtab.h"
 #include <QMessageBox>
+#include "gzipreader.h"
 #include <cmath>
 //using namespace std;
 
@@ -10,10 +11,10 @@ BatchTab::BatchTab(int batchIndex, QWidget *parent, ProjectModel *projectModel)
     , m_plotWidget(nullptr)
     , m_tableView(nullptr)
     , m_tableModel(nullptr)
+    , m_follower(nullptr)
     , m_batchIndex(batchIndex)
     , m_projectModel(nullptr)
 {
-    m_dataPointData = new DataPointData;
     setProjectModel(projectModel);
     setupUI();
     setupControlPanel();
@@ -28,7 +29,7 @@ void BatchTab::setupUI()
 
     // 创建绘图组件
     m_plotWidget = new PlotWidget(this);
-    m_plotWidget->setBatchData(m_dataPointData);
+    m_plotWidget->setBatchData(m_dataPointData.data());
     m_plotWidget->setDesignLinesFile(m_projectModel->getDesignLines());
 
     // 创建右侧分割器（垂直）
@@ -37,7 +38,7 @@ void BatchTab::setupUI()
     // 创建表格视图
     m_tableView = new QTableView(this);
     m_tableModel = new DatTableModel(this);
-    m_tableModel->setBatchData(m_dataPointData);
+    m_tableModel->setBatchData(m_dataPointData.data());
     m_tableView->setModel(m_tableModel);
 
     // 创建控制面板
@@ -160,17 +161,17 @@ void BatchTab::setupControlPanel()
 
     QHBoxLayout *fnCutSpinButtonLayout = new QHBoxLayout();
     m_startFnSpin = new QSpinBox(this);
-    m_startFnSpin->setRange(m_dataPointData->points[0].fn,
-            m_dataPointData->points[m_dataPointData->points.size()-1].fn);
+    m_startFnSpin->setRange(m_dataPointData->points.fn(0),
+            m_dataPointData->points.fn(m_dataPointData->points.size()-1));
     m_startFnSpin->setSingleStep(10.0);
-    m_startFnSpin->setValue(m_dataPointData->points[0].fn);
+    m_startFnSpin->setValue(m_dataPointData->points.fn(0));
     fnCutSpinButtonLayout->addWidget(m_startFnSpin);
 
     m_endFnSpin = new QSpinBox(this);
-    m_endFnSpin->setRange(m_dataPointData->points[0].fn,
-            m_dataPointData->points[m_dataPointData->points.size()-1].fn);
+    m_endFnSpin->setRange(m_dataPointData->points.fn(0),
+            m_dataPointData->points.fn(m_dataPointData->points.size()-1));
     m_endFnSpin->setSingleStep(10.0);
-    m_endFnSpin->setValue(m_dataPointData->points[m_dataPointData->points.size()-1].fn);
+    m_endFnSpin->setValue(m_dataPointData->points.fn(m_dataPointData->points.size()-1));
     fnCutSpinButtonLayout->addWidget(m_endFnSpin);
 
     m_applyFnCutBtn = new QPushButton("裁剪", this);
@@ -203,6 +204,12 @@ void BatchTab::setupControlPanel()
     m_selectionCountLabel = new QLabel(this);
     m_selectedPointLabel = new QLabel(this);
 
+    // 采集机仍在拷贝文件时，边写边看
+    m_followCheck = new QCheckBox("跟踪文件增长", this);
+    m_followCheck->setToolTip("文件仍在写入时，自动读入新追加的数据行");
+    connect(m_followCheck, &QCheckBox::toggled, this, &BatchTab::onFollowToggled);
+
+    statusLayout->addWidget(m_followCheck);
     statusLayout->addWidget(m_pointCountLabel);
     statusLayout->addWidget(m_lineCountLabel);
     statusLayout->addWidget(m_selectionCountLabel);
@@ -224,10 +231,9 @@ void BatchTab::setProjectModel(ProjectModel *model) {
         connect(m_projectModel, &ProjectModel::projectModified,
                 this, [this]() { update(); });
     }
-    QList<DataPoint> &points = m_projectModel->getBatches()[m_batchIndex].points;
-    for (const DataPoint &point : points) {
-        m_dataPointData->addPoint(point);
-    }
+    // 直接引用架次的点数据，不复制；压缩存放的先展开
+    m_dataPointData = m_projectModel->getBatches()[m_batchIndex].data;
+    m_dataPointData->expand();
     m_batchName = m_projectModel->getBatches()[m_batchIndex].batchName;
 }
 
@@ -236,17 +242,14 @@ void BatchTab::updateStatusInfo()
     if (!m_dataPointData)
         return;
 
-    int visiblePoints = 0;
-    for (const DataPoint &point : m_dataPointData->points) {
-        if (point.isVisible) visiblePoints++;
-    }
+    int visiblePoints = m_dataPointData->points.visibleCount();
 
     m_pointCountLabel->setText(QString("可见点: %1 / %2")
                               .arg(visiblePoints)
                               .arg(m_dataPointData->points.size()));
 
     m_lineCountLabel->setText(QString("线条数: %1")
-                             .arg(m_dataPointData->lineMap.size()));
+                             .arg(m_dataPointData->lineMap.lineCount()));
 
     /// TODO: 更新选择计数
     m_selectionCountLabel->setText("选中点: 0");
@@ -258,14 +261,21 @@ void BatchTab::updateSelectedPoint(int index)
         return;
     }
 
-    const DataPoint& point = m_dataPointData->points[index];
+    const PointStore& points = m_dataPointData->points;
 
     // 格式化状态栏信息
     QString info = QString("点号: %1 | 线号: %2")
-                       .arg(point.fn)
-                       .arg(point.lineId);
+                       .arg(points.fn(index))
+                       .arg(points.lineId(index));
 
     m_selectedPointLabel->setText(info);
+
+    // 表格滚动到该点所在行
+    int viewRow = m_tableModel->getViewRow(index);
+    if (viewRow >= 0) {
+        m_tableView->selectRow(viewRow);
+        m_tableView->scrollTo(m_tableModel->index(viewRow, 0));
+    }
 }
 
 void BatchTab::onSelectionChanged()
@@ -286,11 +296,8 @@ void BatchTab::onAltThresholdChanged(double value)
 {
     Q_UNUSED(value);
     if (m_lowAltThresholdSpin->value() < m_highAltThresholdSpin->value()){
-        m_dataPointData->setThreshold(m_lowAltThresholdSpin->value(), m_highAltThresholdSpin->value());
+        m_dataPointData->applyAltThreshold(m_lowAltThresholdSpin->value(), m_highAltThresholdSpin->value());
         updateStatusInfo();
-        for (DataPoint &point: m_dataPointData->points) {
-            point.isNormalAlt = m_dataPointData->isNormalAlt(point.alt);
-        }
         m_plotWidget->invalidatePoints();
 //        m_plotWidget->update();
     }
@@ -300,19 +307,19 @@ void BatchTab::onAltThresholdChanged(double value)
 
 void BatchTab::applyFnCut()
 {
+    int first = -1;
+    int end = 0;
     if (m_startFnSpin->value() < m_endFnSpin->value()) {
-        for (DataPoint &point: m_dataPointData->points) {
-            if (point.fn >= m_startFnSpin->value())
-                point.isVisible = false;
-            if (point.fn >= m_endFnSpin->value())
-                break;
-        }
+        m_dataPointData->hideByFn(m_startFnSpin->value(), m_endFnSpin->value(), &first, &end);
     }
     else
         QMessageBox::warning(this, "错误", "无效的基点号范围设置！");
+    m_tableModel->refreshVisibleRows();
+    updateStatusInfo();
     m_plotWidget->m_pointsDirty = true;
     m_plotWidget->update();
-    syncModel();
+    if (first >= 0)
+        markModified(DataPointData::VisibilityChanged, first, end);
 }
 //void DatFileTab::deleteLowQualityPoints()
 //{
@@ -329,7 +336,7 @@ void BatchTab::applySelection()
 //    for (const QRectF &region : regions) {
 //        m_datFileData->hideByRegion(region, false);
 //    }
-    m_dataPointData->hideByRegion(m_plotWidget->getSelection(), false);
+    const int hidden = m_dataPointData->hideByRegion(m_plotWidget->getSelection(), false);
 
 //    m_dataPointData->regenerateLineNumbers();
     m_tableModel->refreshVisibleRows();
@@ -337,7 +344,8 @@ void BatchTab::applySelection()
 //    m_plotWidget->update();
     updateStatusInfo();
     m_plotWidget->clearSelection();
-    syncModel();
+    if (hidden > 0)
+        markModified(DataPointData::VisibilityChanged, 0, m_dataPointData->points.size());
 }
 
 void BatchTab::zoomToFit()
@@ -353,15 +361,11 @@ void BatchTab::clearSelection()
 void BatchTab::resetDataPoints()
 {
     Batch& batch = getBatch();
-    for (DataPoint& point : batch.points) {
-        point.isVisible = true;
-    }
-    for (DataPoint& point : m_dataPointData->points) {
-        point.isVisible = true;
-    }
+    m_dataPointData->points.setAllVisible(true);
+    m_tableModel->refreshVisibleRows();
+    updateStatusInfo();
     m_plotWidget->m_pointsDirty = true;
     m_plotWidget->update();
-    syncModel();
 
     QList<DesignLineFile>& designLinesFile = m_projectModel->getDesignLines();
     if (batch.relatedLines.size()) {
@@ -383,11 +387,11 @@ void BatchTab::resetDataPoints()
         }
     }
 
-    for (DataPoint& point : m_dataPointData->points) {
-        point.lineId = "0";
-    }
+    m_dataPointData->points.setAllLineIds("0");
+    m_dataPointData->rebuildLineMap();
 
-    syncModel();
+    markModified(DataPointData::VisibilityChanged | DataPointData::LineIdsChanged,
+                 0, m_dataPointData->points.size());
 }
 
 QVector<int> BatchTab::getSelectedPointIndices() const
@@ -481,16 +485,18 @@ void BatchTab::matchLineNumber()
             }
         }
     }
+    PointStore& points = m_dataPointData->points;
     QString lineNumberNowleft;
+    int lineCode = -1;
     DesignLine* closestLine = nullptr;
-    for (int i = 0; i < m_dataPointData->points.size(); i++) {
-        DataPoint& point = m_dataPointData->points[i];
-        if (i == 0 && point.isVisible){ // 整个架次的第一个点，如果可见的话就先计算它的线号吧
+    for (int i = 0; i < points.size(); i++) {
+        const bool visible = points.isVisible(i);
+        if (i == 0 && visible){ // 整个架次的第一个点，如果可见的话就先计算它的线号吧
             double minDistance;
             for (int j = 0; j < designLinesFile.size(); j++) {
                 DesignLineFile& designLineFile = designLinesFile[j];
                 QList<DesignLine>& data = designLineFile.data;
-                auto result = findClosestLineWithDistance(point.coordinate, data);
+                auto result = findClosestLineWithDistance(points.coordinate(i), data);
                 if (j == 0) {
                     minDistance = result.second;
                     closestLine = result.first;
@@ -502,24 +508,26 @@ void BatchTab::matchLineNumber()
             }
             lineNumberNowleft = closestLine->lineName;
             lineNumberNowleft = lineNumberNowleft.left(lineNumberNowleft.size()-1);
-            point.lineId = lineNumberNowleft + QString::number(closestLine->matchTimes);
+            lineCode = points.internLine(lineNumberNowleft + QString::number(closestLine->matchTimes));
+            points.setLineCode(i, lineCode);
         }
-        else if (i > 0 && m_dataPointData->points[i-1].isVisible && point.isVisible) {
+        else if (i > 0 && points.isVisible(i-1) && visible) {
 
-            point.lineId = lineNumberNowleft + QString::number(closestLine->matchTimes);
+            // 同一段内线号不变，沿用上一个点的编码
+            points.setLineCode(i, lineCode);
         }
-        else if (i > 0 && m_dataPointData->points[i-1].isVisible && !point.isVisible) {
+        else if (i > 0 && points.isVisible(i-1) && !visible) {
 
             closestLine->matchTimes++;  // 设计线的匹配次数++
             batch.relatedLines.append(closestLine->lineName);   //将这段赋的线号记录到架次匹配记录中
         }
-        else if (point.isVisible) {
+        else if (visible) {
 
             double minDistance;
             for (int j = 0; j < designLinesFile.size(); j++) {
                 DesignLineFile& designLineFile = designLinesFile[j];
                 QList<DesignLine>& data = designLineFile.data;
-                auto result = findClosestLineWithDistance(point.coordinate, data);
+                auto result = findClosestLineWithDistance(points.coordinate(i), data);
                 if (j == 0) {
                     minDistance = result.second;
                     closestLine = result.first;
@@ -531,10 +539,12 @@ void BatchTab::matchLineNumber()
             }
             lineNumberNowleft = closestLine->lineName;
             lineNumberNowleft = lineNumberNowleft.left(lineNumberNowleft.size()-1);
-            point.lineId = lineNumberNowleft + QString::number(closestLine->matchTimes);
+            lineCode = points.internLine(lineNumberNowleft + QString::number(closestLine->matchTimes));
+            points.setLineCode(i, lineCode);
         }
     }
-    syncModel();
+    m_dataPointData->rebuildLineMap();
+    markModified(DataPointData::LineIdsChanged, 0, points.size());
     QMessageBox::information(
         nullptr,
         tr("成功"),
@@ -563,12 +573,11 @@ void BatchTab::onChangeLineId(QString originalLineId, QString newLineId)
             }
         }
     }
-    for (DataPoint& point : m_dataPointData->points) {
-        if (point.lineId == originalLineId) {
-            point.lineId = newLineId;
-        }
-    }
-    syncModel();
+    // 改名只改线号表，受影响的范围按这条线的首末段登记
+    const QVector<LineRun> runs = m_dataPointData->getLineRuns(originalLineId);
+    m_dataPointData->renameLine(originalLineId, newLineId);
+    if (!runs.isEmpty())
+        markModified(DataPointData::LineIdsChanged, runs.first().begin, runs.last().end);
 }
 
 double BatchTab::distanceBetweenPoints(double x1, double y1, double x2, double y2)
@@ -616,7 +625,88 @@ std::pair<DesignLine*, double> BatchTab::findClosestLineWithDistance(const QPoin
     return {closestLine, minDistance};
 }
 
-void BatchTab::syncModel()
+void BatchTab::onFollowToggled(bool checked)
+{
+    if (!checked) {
+        if (m_follower)
+            m_follower->stop();
+        return;
+    }
+
+    Batch& batch = getBatch();
+    if (batch.filePaths.isEmpty()) {
+        m_followCheck->setChecked(false);
+        return;
+    }
+    if (isGzipFile(batch.filePaths.first())) {
+        QMessageBox::warning(this, "无法跟踪", "压缩文件不会增长，无需跟踪");
+        m_followCheck->setChecked(false);
+        return;
+    }
+
+    if (!m_follower) {
+        m_follower = new BatchFollower(batch.filePaths.first(), batch.columnMapping, this);
+        connect(m_follower, &BatchFollower::pointsAppended, this, &BatchTab::onPointsAppended);
+        connect(m_follower, &BatchFollower::followingStopped, this, &BatchTab::onFollowingStopped);
+    }
+
+    // 读入时末尾那行还没写完的，先去掉由它解析出的点，写完后会重新读入
+    int pendingRows = m_follower->start(batch.parsedBytes, batch.size);
+    pendingRows = qMin(pendingRows, m_dataPointData->points.size());
+    if (pendingRows > 0) {
+        for (int i = 0; i < pendingRows; ++i) {
+            m_dataPointData->removeLastPoint();
+        }
+        batch.size -= pendingRows;
+        batch.parsedBytes = m_follower->parsedEnd();
+        const int size = m_dataPointData->points.size();
+        markModified(DataPointData::PointsRemoved, size, size + pendingRows);
+        m_tableModel->refreshVisibleRows();
+        m_plotWidget->invalidatePoints();
+        updateStatusInfo();
+    }
+}
+
+void BatchTab::stopFollowing()
+{
+    if (m_follower)
+        m_follower->stop();
+    m_followCheck->setChecked(false);
+}
+
+bool BatchTab::isFollowing() const
+{
+    return m_follower && m_follower->isFollowing();
+}
+
+void BatchTab::onPointsAppended(const PointStore& points)
+{
+    const int first = m_dataPointData->points.size();
+    Batch& batch = getBatch();
+    m_dataPointData->addPoints(points);
+    PointStore& allPoints = m_dataPointData->points;
+    batch.size += points.size();
+    batch.parsedBytes = m_follower->parsedEnd();
+    markModified(DataPointData::PointsAppended, first, allPoints.size());
+
+    // 只追加新行、只画新点，不重建表格和点缓存
+    m_tableModel->appendPoints(first);
+    m_plotWidget->appendPoints(first);
+
+    const int lastFn = m_dataPointData->points.fn(m_dataPointData->points.size() - 1);
+    m_startFnSpin->setMaximum(qMax(m_startFnSpin->maximum(), lastFn));
+    m_endFnSpin->setMaximum(qMax(m_endFnSpin->maximum(), lastFn));
+    updateStatusInfo();
+}
+
+void BatchTab::onFollowingStopped(const QString& reason)
+{
+    m_followCheck->setChecked(false);
+    QMessageBox::warning(this, "停止跟踪", reason);
+}
+
+void BatchTab::markModified(int changes, int begin, int end)
 {
-    m_projectModel->m_batches[m_batchIndex].points = m_dataPointData->points;
+    m_dataPointData->markDirty(changes, begin, end);
+    m_projectModel->markBatchModified(m_batchIndex);
 }
@@ -7,6 +7,7 @@
 #include "dattablemodel.h"
 #include <QCheckBox>
 #include "projectmodel.h"
+#include "batchfollower.h"
 
 
 // 单个DAT文件的标签页
@@ -17,7 +18,7 @@ class BatchTab : public QWidget
 public:
     explicit BatchTab(int batchIndex, QWidget *parent = nullptr, ProjectModel* projectModel = nullptr);
 
-    DataPointData* getDataPointData() const { return m_dataPointData; }
+    DataPointData* getDataPointData() const { return m_dataPointData.data(); }
     QString getBatchName() const { return m_batchName; }
     Batch& getBatch() const { return m_projectModel->getBatches()[m_batchIndex]; }
 
@@ -53,7 +54,12 @@ public:
 
     std::pair<DesignLine*, double> findClosestLineWithDistance(const QPointF& point, QList<DesignLine>& lines);
 
-    void syncModel();
+    // 点数据已就地修改：登记修改范围并通知项目，[begin, end)为受影响的点下标
+    void markModified(int changes, int begin, int end);
+
+    // 停止跟踪文件增长，关闭标签页、架次点数据压缩之前调用
+    void stopFollowing();
+    bool isFollowing() const;
 
 public slots:
     void onSelectionChanged();
@@ -66,6 +72,11 @@ public slots:
     void onChangeLineId(QString originalLineId, QString newLineId);
     void applyFnCut();
 
+    // 跟踪首个文件的增长
+    void onFollowToggled(bool checked);
+    void onPointsAppended(const PointStore& points);
+    void onFollowingStopped(const QString& reason);
+
 private:
     void setupUI();
     void setupControlPanel();
@@ -73,7 +84,7 @@ private:
     ColumnMapping m_columnMapping;  // 保存列映射信息
 
 private:
-    DataPointData *m_dataPointData;
+    QSharedPointer<DataPointData> m_dataPointData;    // 与架次共用的点数据
 //    QList<DesignLineFile>& m_designLinesFile;
 //    QList<DesignLine> *m_designLines;
     QString m_batchName;
@@ -118,6 +129,10 @@ private:
 
     QPushButton *m_assignLineNumberBtn;
 
+    // 文件跟踪
+    QCheckBox *m_followCheck;
+    BatchFollower *m_follower;
+
     // 状态信息
     QLabel *m_pointCountLabel;
     QLabel *m_lineCountLabel;
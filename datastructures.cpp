@@ -1,64 +1,196 @@
 #include "datastructures.h"
 #include <QDebug>
+#include <cmath>
 
-QVector<LineSegment> DataPointData::getVisibleLineSegments() const
+void DataPointData::addPoints(const PointStore &newPoints)
 {
-    QVector<LineSegment> segments;
+    const int first = points.size();
+    points.append(newPoints);
+    lineMap.append(points.lineCodeData(), points.fnData(), first, points.size());
+    zones.append(points, first);
+    appendLocalCoords(first);
 
-    // 遍历每条线
-    for (auto it = lineMap.begin(); it != lineMap.end(); ++it) {
-        const QString &lineNumber = it.key();
-        const QVector<int> &pointIndices = it.value();
+    if (m_flagsValid) {
+        for (int i = first; i < points.size(); ++i)
+            points.setNormalAlt(i, isNormalAlt(points.alt(i)));
+    }
+    ++m_revision;
+}
+
+void DataPointData::appendLocalCoords(int first)
+{
+    const int count = points.size();
+    if (first >= count)
+        return;
+
+    const double *xs = points.xData();
+    const double *ys = points.yData();
+    if (first == 0) {
+        // 原点取首个点所在的整公里处，架次范围内各点的局部坐标在float的精度内（厘米级）
+        m_localOrigin = QPointF(std::floor(xs[0] / 1000.0) * 1000.0, std::floor(ys[0] / 1000.0) * 1000.0);
+    }
+
+    const double originX = m_localOrigin.x();
+    const double originY = m_localOrigin.y();
+    m_localX.resize(count);
+    m_localY.resize(count);
+    float *localX = m_localX.data();
+    float *localY = m_localY.data();
+    for (int i = first; i < count; ++i) {
+        localX[i] = float(xs[i] - originX);
+        localY[i] = float(ys[i] - originY);
+    }
+    grid.append(localX, localY, first, count);
+}
+
+void DataPointData::removeLastPoint()
+{
+    if (points.isEmpty())
+        return;
+
+    const int last = points.size() - 1;
+    lineMap.removeLast(points.lineCode(last), last > 0 ? points.fn(last - 1) : 0);
+    grid.removeLast(m_localX.at(last), m_localY.at(last));
+    points.removeLast();
+    zones.truncate(points);
+    m_localX.resize(last);
+    m_localY.resize(last);
+    ++m_revision;
+}
+
+void DataPointData::compact()
+{
+    if (m_compact || points.isEmpty())
+        return;
+
+    m_packed.pack(points);
+    points.clear();
+    lineMap.clear();
+    zones.clear();
+    grid.clear();
+    m_localX = QVector<float>();
+    m_localY = QVector<float>();
+    m_compact = true;
+}
+
+void DataPointData::expand()
+{
+    if (!m_compact)
+        return;
+
+    PointStore unpacked = m_packed.unpack();
+    m_packed.clear();
+    m_compact = false;
+    addPoints(unpacked);
+}
+
+void DataPointData::markDirty(int changes, int begin, int end)
+{
+    if (changes == 0 || begin >= end)
+        return;
+    ++m_revision;
+    if (m_changes == 0) {
+        m_dirtyBegin = begin;
+        m_dirtyEnd = end;
+    } else {
+        m_dirtyBegin = qMin(m_dirtyBegin, begin);
+        m_dirtyEnd = qMax(m_dirtyEnd, end);
+    }
+    m_changes |= changes;
+}
+
+void DataPointData::rebuildLineMap()
+{
+    lineMap.clear();
+    lineMap.append(points.lineCodeData(), points.fnData(), 0, points.size());
+    ++m_revision;
+}
+
+void DataPointData::renameLine(const QString &originalLineId, const QString &newLineId)
+{
+    const int code = points.findLine(originalLineId);
+    if (code < 0 || originalLineId == newLineId)
+        return;
+
+    const int target = points.findLine(newLineId);
+    if (target < 0) {
+        points.renameLine(code, newLineId);
+        return;
+    }
+
+    // 并入已有的线号：改写这条线各点的编码后重建索引，两条线首尾相接的段随之连成一段
+    for (int r = lineMap.firstRun(code); r >= 0; r = lineMap.nextRun(r)) {
+        const LineRun &run = lineMap.run(r);
+        for (int i = run.begin; i < run.end; ++i) {
+            points.setLineCode(i, target);
+        }
+    }
+    rebuildLineMap();
+}
 
-        if (pointIndices.size() < 2) continue;
+QVector<LineSegment> DataPointData::getVisibleLineSegments(QVector<int> &indices) const
+{
+    QVector<LineSegment> segments;
+    indices.clear();
+
+    // 各线的可见点共用一个临时缓冲
+    QVector<int> visibleIndices;
 
-        // 获取可见的点
-        QVector<int> visibleIndices;
-        for (int idx : pointIndices) {
-            if (idx < points.size() && points[idx].isVisible) {
-                visibleIndices.append(idx);
+    // 遍历每条线
+    for (int lineCode = 0; lineCode < lineMap.codeCount(); ++lineCode) {
+        // 获取可见的点，整段隐藏的由位图计数直接跳过
+        visibleIndices.clear();
+        for (int r = lineMap.firstRun(lineCode); r >= 0; r = lineMap.nextRun(r)) {
+            const LineRun &run = lineMap.run(r);
+            if (points.visibleRank(run.end) == points.visibleRank(run.begin)) continue;
+            for (int idx = run.begin; idx < run.end; ++idx) {
+                if (points.isVisible(idx)) {
+                    visibleIndices.append(idx);
+                }
             }
         }
 
         if (visibleIndices.size() < 2) continue;
 
-        // 根据质量分段
+        // 根据质量分段，各段的点下标依次写入indices
         LineSegment currentSegment;
-        currentSegment.lineId = lineNumber;
+        currentSegment.lineCode = lineCode;
+        currentSegment.first = indices.size();
 
         for (int i = 0; i < visibleIndices.size(); ++i) {
             int idx = visibleIndices[i];
-            const DataPoint &point = points[idx];
+            const double alt = points.alt(idx);
 
-            bool isHighQuality = (point.alt >= lowAltThreshold && point.alt <= highAltThreshold);
+            bool isHighQuality = (alt >= lowAltThreshold && alt <= highAltThreshold);
 
             // 如果质量状态改变或者是第一个点，开始新的段
-            if (currentSegment.pointIndices.isEmpty()) {
+            if (currentSegment.count == 0) {
                 currentSegment.hasNormalAlt = isHighQuality;
-                currentSegment.pointIndices.append(idx);
             } else if (currentSegment.hasNormalAlt != isHighQuality) {
-                // 质量状态改变，结束当前段并开始新段
-                if (currentSegment.pointIndices.size() >= 2) {
+                // 质量状态改变，结束当前段并开始新段，不足两点的段从缓冲中退回
+                if (currentSegment.count >= 2) {
                     segments.append(currentSegment);
+                } else {
+                    indices.resize(currentSegment.first);
                 }
 
                 // 开始新段，但要包含前一个点以保持连续性
                 currentSegment = LineSegment();
-                currentSegment.lineId = lineNumber;
+                currentSegment.lineCode = lineCode;
                 currentSegment.hasNormalAlt = isHighQuality;
-                if (i > 0) {
-                    currentSegment.pointIndices.append(visibleIndices[i-1]);
-                }
-                currentSegment.pointIndices.append(idx);
-            } else {
-                // 质量状态相同，继续当前段
-                currentSegment.pointIndices.append(idx);
+                currentSegment.first = indices.size();
+                indices.append(visibleIndices[i-1]);
+                ++currentSegment.count;
             }
+            indices.append(idx);
+            ++currentSegment.count;
         }
 
         // 添加最后一个段
-        if (currentSegment.pointIndices.size() >= 2) {
+        if (currentSegment.count >= 2) {
             segments.append(currentSegment);
+        } else {
+            indices.resize(currentSegment.first);
         }
     }
 
@@ -74,95 +206,182 @@ QVector<LineSegment> DataPointData::getVisibleLineSegments() const
 //    }
 //}
 
-void DataPointData::hideByRegion(const QPolygonF &region, bool invert)
+int DataPointData::hideByRegion(const QPolygonF &region, bool invert)
 {
-    for (DataPoint &point : points) {
-        bool inRegion = region.containsPoint(point.coordinate, Qt::OddEvenFill);
-        if (invert) {
-            // 反选：选区外的点被隐藏
-            if (!inRegion) {
-                point.isVisible = false;
+    int hidden = 0;
+    // 只读X、Y两列，已隐藏的点不再判断
+    // 先用选区的外接矩形判断：与之不相交的块整块在选区外，外接矩形外的点也不必逐边判断
+    const QRectF bounds = region.boundingRect();
+    const double *xs = points.xData();
+    const double *ys = points.yData();
+    for (int b = 0; b < zones.blockCount(); ++b) {
+        const bool outside = !zones.zone(b).overlaps(bounds);
+        if (outside && !invert)
+            continue;
+        for (int i = zones.blockBegin(b); i < zones.blockEnd(b); ++i) {
+            if (!points.isVisible(i))
+                continue;
+            const QPointF point(xs[i], ys[i]);
+            bool inRegion = !outside && bounds.contains(point)
+                    && region.containsPoint(point, Qt::OddEvenFill);
+            // 正选：选区内的点被隐藏；反选：选区外的点被隐藏
+            if (inRegion != invert) {
+                points.setVisible(i, false);
+                ++hidden;
             }
-        } else {
-            // 正选：选区内的点被隐藏
-            if (inRegion) {
-                point.isVisible = false;
+        }
+    }
+    if (hidden > 0)
+        ++m_revision;
+    return hidden;
+}
+
+int DataPointData::hideByFn(int startFn, int endFn, int *first, int *end)
+{
+    int hidden = 0;
+    *first = -1;
+    *end = 0;
+    // 块内最大点号小于两者时，块内既没有要隐藏的点，也没有停止处
+    const int *fns = points.fnData();
+    const int minFn = qMin(startFn, endFn);
+    bool stop = false;
+    for (int b = 0; b < zones.blockCount() && !stop; ++b) {
+        if (zones.zone(b).maxFn < minFn)
+            continue;
+        for (int i = zones.blockBegin(b); i < zones.blockEnd(b); ++i) {
+            if (fns[i] >= startFn) {
+                if (points.isVisible(i)) {
+                    points.setVisible(i, false);
+                    ++hidden;
+                }
+                if (*first < 0)
+                    *first = i;
+                *end = i + 1;
+            }
+            if (fns[i] >= endFn) {
+                stop = true;
+                break;
             }
         }
     }
+    if (hidden > 0)
+        ++m_revision;
+    return hidden;
 }
 
-void DataPointData::regenerateLineNumbers()
+void DataPointData::applyAltThreshold(double lowThreshold, double highThreshold)
 {
-    // 清空原有的线映射
-    lineMap.clear();
+    const bool incremental = m_flagsValid;
+    const double oldLow = m_flagLow;
+    const double oldHigh = m_flagHigh;
+    setThreshold(lowThreshold, highThreshold);
+    m_flagLow = lowThreshold;
+    m_flagHigh = highThreshold;
+    m_flagsValid = true;
 
-    // 重新构建线映射，只包含可见的点
-    QHash<QString, QVector<int>> tempLineMap;
+    // 标志可能改变的点，高度在新旧下阈之间或新旧上阈之间
+    auto mayChange = [&](const ZoneMap::Zone &zone) {
+        return (oldLow != lowThreshold && zone.overlapsAlt(qMin(oldLow, lowThreshold), qMax(oldLow, lowThreshold)))
+                || (oldHigh != highThreshold && zone.overlapsAlt(qMin(oldHigh, highThreshold), qMax(oldHigh, highThreshold)));
+    };
 
-    for (int i = 0; i < points.size(); ++i) {
-        if (points[i].isVisible) {
-            tempLineMap[points[i].lineId].append(i);
-        }
+    const double *alts = points.altData();
+    for (int b = 0; b < zones.blockCount(); ++b) {
+        if (incremental && !mayChange(zones.zone(b)))
+            continue;
+        for (int i = zones.blockBegin(b); i < zones.blockEnd(b); ++i)
+            points.setNormalAlt(i, isNormalAlt(alts[i]));
     }
+    ++m_revision;
+}
 
-    // 对于每条线，检查是否需要分割
-    for (auto it = tempLineMap.begin(); it != tempLineMap.end(); ++it) {
-        const QString &originalLineNumber = it.key();
-        const QVector<int> &pointIndices = it.value();
+void DataPointData::regenerateLineNumbers()
+{
+    // 按线检查可见点的点号是否连续，不连续处分割为新线号；隐藏的点保留原线号
+    // 各子线的可见点范围依次存放在一个缓冲中，不为每条子线单独分配
+    QVector<LineRun> ranges;
+    QVector<int> subLineStarts;     // 各子线在ranges中的起始位置，末尾多一项为总数
 
-        if (pointIndices.size() < 2) {
+    const int codeCount = lineMap.codeCount();
+    for (int originalCode = 0; originalCode < codeCount; ++originalCode) {
+        if (lineMap.firstRun(originalCode) < 0) {
             continue;
         }
+        ranges.clear();
+        subLineStarts.clear();
+        int currentStart = 0;
+        int currentCount = 0;
+        int lastIdx = -1;
 
-        // 检查点号是否连续，如果不连续则分割线
-        QVector<QVector<int>> subLines;
-        QVector<int> currentSubLine;
+        auto finishSubLine = [&]() {
+            if (currentCount >= 2) {
+                subLineStarts.append(currentStart);
+            } else {
+                ranges.resize(currentStart);
+            }
+            currentStart = ranges.size();
+            currentCount = 0;
+        };
+        auto appendRange = [&](int begin, int end) {
+            if (currentCount > 0 && ranges.last().end == begin) {
+                ranges.last().end = end;
+            } else {
+                ranges.append(LineRun(begin, end, points.fn(begin), points.fn(end - 1), 0));
+            }
+            currentCount += end - begin;
+            lastIdx = end - 1;
+        };
 
-        for (int i = 0; i < pointIndices.size(); ++i) {
-            int currentIdx = pointIndices[i];
+        for (int r = lineMap.firstRun(originalCode); r >= 0; r = lineMap.nextRun(r)) {
+            const LineRun &run = lineMap.run(r);
+            const int visible = points.visibleRank(run.end) - points.visibleRank(run.begin);
+            if (visible == 0) {
+                continue;
+            }
 
-            if (currentSubLine.isEmpty()) {
-                currentSubLine.append(currentIdx);
-            } else {
-                int lastIdx = currentSubLine.last();
-                int currentPointNum = points[currentIdx].fn;
-                int lastPointNum = points[lastIdx].fn;
+            // 整段可见且段内点号连续时整段并入，只比较段首与前一个可见点
+            if (visible == run.size() && run.maxFnStep <= 1) {
+                if (lastIdx >= 0 && run.firstFn - points.fn(lastIdx) > 1) {
+                    finishSubLine();
+                }
+                appendRange(run.begin, run.end);
+                continue;
+            }
 
+            for (int i = run.begin; i < run.end; ++i) {
+                if (!points.isVisible(i)) {
+                    continue;
+                }
                 // 如果点号不连续（相差超过1），则开始新的子线
-                if (currentPointNum - lastPointNum > 1) {
-                    if (currentSubLine.size() >= 2) {
-                        subLines.append(currentSubLine);
-                    }
-                    currentSubLine.clear();
+                if (lastIdx >= 0 && points.fn(i) - points.fn(lastIdx) > 1) {
+                    finishSubLine();
                 }
-                currentSubLine.append(currentIdx);
+                appendRange(i, i + 1);
             }
         }
 
         // 添加最后一个子线
-        if (currentSubLine.size() >= 2) {
-            subLines.append(currentSubLine);
-        }
+        finishSubLine();
 
-        // 更新线号和映射
-        if (subLines.size() == 1)  {
-            // 没有分割，保持原线号
-            lineMap[originalLineNumber] = subLines[0];
-        } else {
-            // 分割了，生成新的线号
-            for (int subIdx = 0; subIdx < subLines.size(); ++subIdx) {
-                QString newLineNumber = QString("%1%2").arg(originalLineNumber).arg(subIdx + 1);
+        // 没有分割，保持原线号
+        if (subLineStarts.size() < 2) {
+            continue;
+        }
+        subLineStarts.append(ranges.size());
 
-                // 更新点的线号
-                for (int pointIdx : subLines[subIdx]) {
-                    points[pointIdx].lineId = newLineNumber;
+        // 分割了，生成新的线号
+        for (int subIdx = 0; subIdx + 1 < subLineStarts.size(); ++subIdx) {
+            QString newLineNumber = QString("%1%2").arg(points.lineName(originalCode)).arg(subIdx + 1);
+            const int code = points.internLine(newLineNumber);
+            for (int k = subLineStarts[subIdx]; k < subLineStarts[subIdx + 1]; ++k) {
+                for (int pointIdx = ranges[k].begin; pointIdx < ranges[k].end; ++pointIdx) {
+                    points.setLineCode(pointIdx, code);
                 }
-
-                lineMap[newLineNumber] = subLines[subIdx];
             }
         }
     }
+
+    rebuildLineMap();
 }
 
 ///待写
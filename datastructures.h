@@ -5,6 +5,11 @@
 #include <QObject>
 #include <QVector>
 #include <QTableView>
+#include "pointstore.h"
+#include "packedpoints.h"
+#include "lineindex.h"
+#include "spatialgrid.h"
+#include "zonemap.h"
 
 // 数据点结构
 struct DataPoint {
@@ -24,6 +29,29 @@ struct DataPoint {
     static DataPoint fromJson(const QJsonObject& json);
 };
 
+// 列映射：各字段在数据文件中的列号，-1表示未选择
+struct ColumnMapping{
+    int lineIdColumn = -1;
+    int fnColumn = -1;
+    int xCoordinateColumn = -1;
+    int yCoordinateColumn = -1;
+    int offsetColumn = -1;
+
+    bool isValid() const{
+        return lineIdColumn >= 0 && fnColumn >= 0 &&
+                xCoordinateColumn >= 0 && yCoordinateColumn >= 0 &&
+                offsetColumn >= 0;
+    }
+
+    bool operator==(const ColumnMapping& other) const{
+        return lineIdColumn == other.lineIdColumn && fnColumn == other.fnColumn &&
+                xCoordinateColumn == other.xCoordinateColumn &&
+                yCoordinateColumn == other.yCoordinateColumn &&
+                offsetColumn == other.offsetColumn;
+    }
+    bool operator!=(const ColumnMapping& other) const{ return !(*this == other); }
+};
+
 // 设计线结构
 struct DesignLine {
     QString lineName;
@@ -37,49 +65,131 @@ struct DesignLine {
     static DesignLine fromJson(const QJsonObject& json);
 };
 
-//线段结构
+//线段结构：各段的点索引依次存放在调用方提供的同一个缓冲中，线段只记位置
 struct LineSegment {
-    QVector<int> pointIndices;  // 引用原始数据点的索引
-    QString lineId;             // 线号
+    int first;                  // 在点索引缓冲中的起始位置
+    int count;                  // 点数
+    int lineCode;               // 线号编码，线号文本由points.lineName()取得
     bool hasNormalAlt;          // 是否包含正常高度点
 
 
-    LineSegment() : hasNormalAlt(true) {}
+    LineSegment() : first(0), count(0), lineCode(-1), hasNormalAlt(true) {}
 };
 
+// 一个架次的点数据，由架次和打开它的标签页共用同一份，编辑时就地修改
 class DataPointData{
 public:
-    QList<DataPoint> points;              // 所有数据点
-    QHash<QString, QVector<int>> lineMap;   // 线号到点索引的映射，<线号, [fn1, fn2, ...]>
+    // 自上次保存以来的修改种类，可按位组合
+    enum Change {
+        VisibilityChanged = 0x01,   // 隐藏或恢复了点
+        LineIdsChanged = 0x02,      // 改写了线号
+        PointsAppended = 0x04,      // 追加了点
+        PointsRemoved = 0x08        // 去掉了末尾的点
+    };
+
+    PointStore points;                    // 所有数据点
+    LineIndex lineMap;                      // 线号编码到点下标范围的索引，各段按下标升序，每条线通常只有一段
+    ZoneMap zones;                          // 每块点的点号、高度、坐标范围，供范围条件跳过整块
+    SpatialGrid grid;                       // 按局部坐标划分的网格，绘图时只取视口内的点
     QString batchName;                       // 文件名
     double lowAltThreshold;                 // 高度下阈
     double highAltThreshold;
 
-    DataPointData() : lowAltThreshold(80), highAltThreshold(120) {}  //缺省阈值
+    DataPointData() : lowAltThreshold(80), highAltThreshold(120),
+        m_flagLow(0), m_flagHigh(0), m_flagsValid(false),
+        m_compact(false), m_changes(0), m_dirtyBegin(0), m_dirtyEnd(0), m_revision(0) {}  //缺省阈值
+
+    // 清空所有点和索引
+    void clear(){
+        points.clear();
+        lineMap.clear();
+        zones.clear();
+        grid.clear();
+        m_packed.clear();
+        m_compact = false;
+        m_localX = QVector<float>();
+        m_localY = QVector<float>();
+        ++m_revision;
+    }
+
+    // 压缩驻留：架次不在当前标签页中显示时把点压缩存放，points和各索引清空；
+    // 切换到该架次的标签页时展开，绘图、编辑和匹配直接读取points的各列
+    void compact();
+    void expand();
+    bool isCompact() const { return m_compact; }
+
+    // 点数、可见性和按行取点，压缩时经解码缓存读取，用于项目保存和后台标签页的表格
+    int pointCount() const { return m_compact ? m_packed.size() : points.size(); }
+    const PointBitset &visibility() const { return m_compact ? m_packed.visibility() : points.visibility(); }
+    DataPoint pointAt(int i) const { return m_compact ? m_packed.at(i) : points.at(i); }
+
+    // 登记一次修改，[begin, end)为受影响的点下标范围，与之前登记的范围合并
+    void markDirty(int changes, int begin, int end);
+    void clearDirty(){ m_changes = 0; m_dirtyBegin = m_dirtyEnd = 0; }
+    bool isDirty() const { return m_changes != 0; }
+    int dirtyChanges() const { return m_changes; }
+    int dirtyBegin() const { return m_dirtyBegin; }
+    int dirtyEnd() const { return m_dirtyEnd; }
+
+    // 数据版本：点、可见性、高度标志或线号编码改变时递增，绘图的各级缓存据此判断是否过期
+    quint64 revision() const { return m_revision; }
 
     void addPoint(const DataPoint& point){
-        int index = points.size();
         points.append(point);
-        lineMap[point.lineId].append(index);
+        lineMap.append(points.lineCodeData(), points.fnData(), points.size() - 1, points.size());
+        zones.append(points, points.size() - 1);
+        appendLocalCoords(points.size() - 1);
+        ++m_revision;
     }
 
-    QVector<LineSegment> getVisibleLineSegments() const;
+    // 整批加入点，按线号建立索引；已按阈值设置过高度标志时，新点的标志随之设置
+    void addPoints(const PointStore& newPoints);
+
+    void removeLastPoint();
+
+    // 显示坐标：各点相对本架次原点的float坐标，只在追加、去掉点时随之更新
+    // 供绘图、点选和空间索引逐点读取，数据量是double坐标的一半；
+    // 导出、选区裁剪和匹配仍用points中的double坐标
+    QPointF localOrigin() const { return m_localOrigin; }
+    const float *localX() const { return m_localX.constData(); }
+    const float *localY() const { return m_localY.constData(); }
+    // 显示坐标各列（隐式共享，不复制数据），供后台绘制取快照
+    QVector<float> localXColumn() const { return m_localX; }
+    QVector<float> localYColumn() const { return m_localY; }
+
+    // 按高度质量分段的可见线段，各段的点索引写入indices（先清空，可在多次调用间复用）
+    QVector<LineSegment> getVisibleLineSegments(QVector<int>& indices) const;
 
     void setThreshold(double lowThreshold, double highThreshold){
         lowAltThreshold = lowThreshold;
         highAltThreshold = highThreshold;
     }
 
-    //获取指定线号的所有点索引
-    QVector<int> getPointIndicesForLine(const QString& lineNumber) const{
-        return lineMap.value(lineNumber);
+    // 设置高度阈值并更新各点的高度正常标志
+    // 各点已按上次的阈值设置过时，只有高度落在新旧阈值之间的点可能改变，其余的块跳过
+    void applyAltThreshold(double lowThreshold, double highThreshold);
+
+    //获取指定线号的各段点下标范围
+    QVector<LineRun> getLineRuns(const QString& lineNumber) const{
+        return lineMap.runs(points.findLine(lineNumber));
     }
 
+    // 按各点当前的线号编码重建lineMap，批量改写线号后调用
+    void rebuildLineMap();
+
+    // 线号改名：新线号尚未使用时只改线号表中的一项，不改写各点；
+    // 新线号已被其他线使用时，只把这条线的点并入该线号
+    void renameLine(const QString& originalLineId, const QString& newLineId);
+
     // 删除高度异常点（视图层）
 //    void hideByOffset(double threshold);
 
-    //删除选区点（视图层）
-    void hideByRegion(const QPolygonF& region, bool invert = false);
+    //删除选区点（视图层），返回新隐藏的点数
+    int hideByRegion(const QPolygonF& region, bool invert = false);
+
+    // 按点号裁剪（视图层）：依次隐藏点号不小于startFn的点，隐藏第一个点号不小于endFn的点后停止
+    // [*first, *end)为裁剪到的点下标范围，没有时*first为-1；返回新隐藏的点数
+    int hideByFn(int startFn, int endFn, int *first, int *end);
 
     ///需重写！重新生成线号
     void regenerateLineNumbers();
@@ -94,7 +204,23 @@ public:
 
 
 private:
-
+    // 为[first, size())中的点计算显示坐标，first为0时重新确定原点
+    void appendLocalCoords(int first);
+
+    double m_flagLow;       // 各点高度标志所依据的阈值，m_flagsValid为false时尚未设置
+    double m_flagHigh;
+    bool m_flagsValid;
+
+    QPointF m_localOrigin;
+    QVector<float> m_localX;
+    QVector<float> m_localY;
+
+    PackedPoints m_packed;  // 压缩存放的点，m_compact为true时有效
+    bool m_compact;
+    int m_changes;          // 自上次保存以来的修改种类
+    int m_dirtyBegin;       // 修改过的点下标范围[m_dirtyBegin, m_dirtyEnd)
+    int m_dirtyEnd;
+    quint64 m_revision;
 };
 
 #endif  //DATASRUCTURE_H
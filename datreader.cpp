@@ -0,0 +1,677 @@
+#include "datreader.h"
+#include "numparse.h"
+#include <QDebug>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QVarLengthArray>
+#include <QVector>
+#include <climits>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DATREADER_HAVE_SSE2
+#endif
+
+namespace {
+
+// 原始字节上的一个字段，不拷贝数据
+struct FieldSpan {
+    const char *begin;
+    const char *end;
+
+    int length() const { return int(end - begin); }
+};
+
+// 从p开始取本行的下一个字段，本行已无字段时返回false
+inline bool nextField(const char *&p, const char *lineEnd, FieldSpan &field)
+{
+    while (p < lineEnd && DatReader::isSeparator(*p))
+        ++p;
+    if (p >= lineEnd)
+        return false;
+
+    field.begin = p;
+    while (p < lineEnd && !DatReader::isSeparator(*p))
+        ++p;
+    field.end = p;
+    return true;
+}
+
+inline const char *findLineEnd(const char *p, const char *end)
+{
+    const void *hit = memchr(p, '\n', size_t(end - p));
+    return hit ? static_cast<const char *>(hit) : end;
+}
+
+// 定宽行中取出固定字节区间内的唯一字段
+// 区间为空、含多个字段或字段越出区间边界时返回false，由调用方退回逐列切分
+// 区间终点落在行尾时不读取该字节，文件最后一行没有换行符时行尾即缓冲区末尾
+inline bool slotField(const char *rowStart, const char *rowEnd, int slotBegin, int slotEnd, FieldSpan &field)
+{
+    const char *slotBeginPtr = rowStart + slotBegin;
+    const char *slotEndPtr = rowStart + slotEnd;
+    const char *p = slotBeginPtr;
+    if (!nextField(p, slotEndPtr, field))
+        return false;
+    if (field.begin == slotBeginPtr && slotBegin > 0 && !DatReader::isSeparator(field.begin[-1]))
+        return false;
+    if (field.end == slotEndPtr && slotEndPtr < rowEnd && !DatReader::isSeparator(*slotEndPtr))
+        return false;
+    FieldSpan extra;
+    return !nextField(p, slotEndPtr, extra);
+}
+
+// 按解析计划取出一行中的各字段，字段数不足（不是数据行）时返回false
+// columnSpans至少能容纳plan.requiredFields个字段
+inline bool splitRow(const char *lineStart, const char *lineEnd, const DatParsePlan &plan,
+                     FieldSpan *columnSpans, FieldSpan (&fields)[DatParsePlan::FieldCount])
+{
+    // 定宽快速路径：按固定字节区间直接取字段，跳过中间未映射的列
+    if (plan.fixedWidth && lineEnd - lineStart + 1 == plan.rowStride) {
+        bool parsed = true;
+        for (int f = 0; f < DatParsePlan::FieldCount && parsed; ++f)
+            parsed = slotField(lineStart, lineEnd, plan.slotBegin[f], plan.slotEnd[f], fields[f]);
+        if (parsed)
+            return true;
+    }
+
+    int fieldCount = 0;
+    const char *cursor = lineStart;
+    while (fieldCount < plan.requiredFields
+           && nextField(cursor, lineEnd, columnSpans[fieldCount]))
+        ++fieldCount;
+    if (fieldCount < plan.requiredFields)
+        return false;
+
+    for (int f = 0; f < DatParsePlan::FieldCount; ++f)
+        fields[f] = columnSpans[plan.columns[f]];
+    return true;
+}
+
+// 一行主键（线号文本和FN数值）的哈希：FNV-1a后再做一次混合，使相邻FN的哈希差异足够大
+inline quint64 rowKeyHash(const FieldSpan &id, int fn)
+{
+    quint64 hash = 14695981039346656037ULL;
+    for (const char *p = id.begin; p < id.end; ++p) {
+        hash ^= uchar(*p);
+        hash *= 1099511628211ULL;
+    }
+    hash ^= quint32(fn);
+    hash *= 1099511628211ULL;
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+// 块哈希按行顺序链式累加，行的顺序不同时结果也不同
+inline quint64 chainHash(quint64 blockHash, quint64 rowHash)
+{
+    blockHash ^= rowHash;
+    blockHash *= 0xc4ceb9fe1a85ec53ULL;
+    return blockHash ^ (blockHash >> 29);
+}
+
+// 定宽检测时采样的数据行数
+const int FixedWidthSampleRows = 64;
+
+// 每个分块至少4MB，避免线程调度开销超过解析本身
+const qint64 MinChunkBytes = 4 * 1024 * 1024;
+
+// 每解析这么多行汇报一次进度并检查取消标志
+const int ProgressRowInterval = 16384;
+
+// 解析单个分块的任务，完成后释放信号量
+class ParseChunkTask : public QRunnable
+{
+public:
+    ParseChunkTask(const char *begin, const char *end, const DatParsePlan *plan,
+                   PointStore *points, int *count, DatReader::ParseProgress *progress,
+                   QVector<qint64> *rowOffsets, QVector<quint64> *rowKeys, QSemaphore *done)
+        : m_begin(begin), m_end(end), m_plan(plan), m_points(points), m_count(count)
+        , m_progress(progress), m_rowOffsets(rowOffsets), m_rowKeys(rowKeys), m_done(done) {}
+
+    void run() override
+    {
+        *m_count = DatReader::parseRows(m_begin, m_end, *m_plan, *m_points, m_progress,
+                                        m_rowOffsets, m_rowKeys);
+        m_done->release();
+    }
+
+private:
+    const char *m_begin;
+    const char *m_end;
+    const DatParsePlan *m_plan;
+    PointStore *m_points;
+    int *m_count;
+    DatReader::ParseProgress *m_progress;
+    QVector<qint64> *m_rowOffsets;
+    QVector<quint64> *m_rowKeys;
+    QSemaphore *m_done;
+};
+
+}
+
+MappedDatFile::MappedDatFile(const QString &filePath)
+    : m_file(filePath)
+    , m_map(nullptr)
+    , m_data(nullptr)
+    , m_size(0)
+    , m_headerOffset(-1)
+    , m_bodyOffset(-1)
+{
+}
+
+MappedDatFile::~MappedDatFile()
+{
+    close();
+}
+
+bool MappedDatFile::open()
+{
+    close();
+    if (!m_file.open(QIODevice::ReadOnly))
+        return false;
+
+    m_size = m_file.size();
+    if (m_size > 0) {
+        m_map = m_file.map(0, m_size);
+        if (!m_map) {
+            qWarning() << "无法映射文件:" << m_file.fileName();
+            m_file.close();
+            m_size = 0;
+            return false;
+        }
+        m_data = reinterpret_cast<const char *>(m_map);
+    }
+
+    findHeader();
+    return true;
+}
+
+void MappedDatFile::close()
+{
+    if (m_map) {
+        m_file.unmap(m_map);
+        m_map = nullptr;
+    }
+    if (m_file.isOpen())
+        m_file.close();
+    m_data = nullptr;
+    m_size = 0;
+    m_headerOffset = -1;
+    m_bodyOffset = -1;
+}
+
+void MappedDatFile::findHeader()
+{
+    const char *end = m_data + m_size;
+    const char *header = DatReader::findHeaderLine(m_data, end);
+    if (!header)
+        return;
+
+    const char *lineEnd = findLineEnd(header, end);
+    m_headerOffset = header - m_data;
+    m_bodyOffset = (lineEnd < end) ? (lineEnd + 1 - m_data) : m_size;
+}
+
+QStringList MappedDatFile::headerColumns() const
+{
+    if (m_headerOffset < 0)
+        return QStringList();
+
+    const char *header = m_data + m_headerOffset;
+    return DatReader::splitFields(header, findLineEnd(header, m_data + m_size));
+}
+
+const char *DatReader::findHeaderLine(const char *begin, const char *end)
+{
+    const char *p = begin;
+
+    // 跳过UTF-8 BOM
+    if (end - p >= 3 && memcmp(p, "\xEF\xBB\xBF", 3) == 0)
+        p += 3;
+
+    while (p < end) {
+        const char *lineEnd = findLineEnd(p, end);
+        const char *cursor = p;
+        FieldSpan first;
+        if (nextField(cursor, lineEnd, first)
+                && first.length() == 4 && memcmp(first.begin, "LINE", 4) == 0) {
+            return p;
+        }
+        p = lineEnd + 1;
+    }
+    return nullptr;
+}
+
+QStringList DatReader::splitFields(const char *begin, const char *end)
+{
+    QStringList fields;
+    const char *p = begin;
+    FieldSpan field;
+    while (nextField(p, end, field))
+        fields.append(QString::fromUtf8(field.begin, field.length()));
+    return fields;
+}
+
+DatParsePlan::DatParsePlan()
+    : requiredFields(0)
+    , fixedWidth(false)
+    , rowStride(0)
+{
+    const int defaults[FieldCount] = { 0, 1, 4, 5, 7 };
+    setColumns(defaults);
+}
+
+void DatParsePlan::setColumns(const int (&cols)[FieldCount])
+{
+    requiredFields = 0;
+    for (int f = 0; f < FieldCount; ++f) {
+        columns[f] = cols[f];
+        slotBegin[f] = 0;
+        slotEnd[f] = 0;
+        requiredFields = qMax(requiredFields, cols[f] + 1);
+    }
+}
+
+DatParsePlan DatParsePlan::build(const MappedDatFile &file, const ColumnMapping &mapping)
+{
+    if (!file.hasBody())
+        return build(file.headerColumns(), nullptr, nullptr, mapping);
+    return build(file.headerColumns(), file.bodyBegin(), file.bodyEnd(), mapping);
+}
+
+DatParsePlan DatParsePlan::build(const QStringList &header, const char *sampleBegin,
+                                 const char *sampleEnd, const ColumnMapping &mapping)
+{
+    DatParsePlan plan;
+
+    if (mapping.isValid()) {
+        const int cols[FieldCount] = {
+            mapping.lineIdColumn, mapping.fnColumn,
+            mapping.xCoordinateColumn, mapping.yCoordinateColumn, mapping.offsetColumn
+        };
+        plan.setColumns(cols);
+    } else {
+        // 按表头列名匹配，列被调换顺序时仍能正确解析
+        int cols[FieldCount] = { -1, -1, -1, -1, -1 };
+        for (int i = 0; i < header.size(); ++i) {
+            const QString name = header[i].toUpper();
+            int field = -1;
+            if (name == "LINE") field = LineId;
+            else if (name == "FN") field = Fn;
+            else if (name == "X") field = X;
+            else if (name == "Y") field = Y;
+            else if (name == "RALT" || name == "ALT") field = Alt;
+            if (field >= 0 && cols[field] < 0)
+                cols[field] = i;
+        }
+        bool matched = true;
+        for (int f = 0; f < FieldCount; ++f)
+            matched = matched && cols[f] >= 0;
+        if (matched)
+            plan.setColumns(cols);
+    }
+
+    if (sampleBegin < sampleEnd)
+        plan.detectFixedWidth(sampleBegin, sampleEnd);
+    return plan;
+}
+
+void DatParsePlan::detectFixedWidth(const char *begin, const char *end)
+{
+    fixedWidth = false;
+
+    // 多取一列，用来确定最后一个映射列的右边界
+    const int sampledColumns = requiredFields + 1;
+    QVector<int> minBegin(sampledColumns, INT_MAX);
+    QVector<int> maxEnd(sampledColumns, -1);
+    int stride = 0;
+    int contentLength = 0;
+    int columnCount = 0;
+    int rows = 0;
+
+    const char *lineStart = begin;
+    while (lineStart < end && rows < FixedWidthSampleRows) {
+        const char *lineEnd = findLineEnd(lineStart, end);
+        if (lineEnd == end)
+            break;      // 最后一行可能还不完整
+        const char *contentEnd = lineEnd;
+        if (contentEnd > lineStart && contentEnd[-1] == '\r')
+            --contentEnd;
+
+        int n = 0;
+        FieldSpan field;
+        const char *cursor = lineStart;
+        while (n < sampledColumns && nextField(cursor, contentEnd, field)) {
+            minBegin[n] = qMin(minBegin[n], int(field.begin - lineStart));
+            maxEnd[n] = qMax(maxEnd[n], int(field.end - lineStart));
+            ++n;
+        }
+
+        const int lineStride = int(lineEnd + 1 - lineStart);
+        if (rows == 0) {
+            stride = lineStride;
+            contentLength = int(contentEnd - lineStart);
+            columnCount = n;
+        } else if (lineStride != stride || n != columnCount) {
+            return;
+        }
+        ++rows;
+        lineStart = lineEnd + 1;
+    }
+
+    if (rows < 2 || columnCount < requiredFields)
+        return;
+
+    // 相邻两列在样本中出现过重叠，说明不是按固定列宽排版
+    for (int c = 1; c < columnCount; ++c) {
+        if (maxEnd[c - 1] >= minBegin[c])
+            return;
+    }
+
+    // 每个字段的区间取到相邻列的边界为止，兼容左对齐和右对齐
+    for (int f = 0; f < FieldCount; ++f) {
+        const int c = columns[f];
+        slotBegin[f] = (c == 0) ? 0 : maxEnd[c - 1];
+        slotEnd[f] = (c + 1 < columnCount) ? minBegin[c + 1] : contentLength;
+    }
+    rowStride = stride;
+    fixedWidth = true;
+}
+
+int DatReader::parseRows(const char *begin, const char *end, const DatParsePlan &plan,
+                         PointStore &points, ParseProgress *progress,
+                         QVector<qint64> *rowOffsets, QVector<quint64> *rowKeys)
+{
+    if (begin >= end)
+        return 0;
+
+    // 按首行长度估算行数，预留空间
+    const qint64 firstLineLength = findLineEnd(begin, end) - begin + 1;
+    const qint64 estimatedRows = (end - begin) / qMax<qint64>(firstLineLength, 1);
+    points.reserve(points.size() + int(qMin<qint64>(estimatedRows, INT_MAX / 2)));
+    if (rowOffsets)
+        rowOffsets->reserve(rowOffsets->size() + int(qMin<qint64>(estimatedRows, INT_MAX / 2)));
+    if (rowKeys)
+        rowKeys->reserve(rowKeys->size() + int(qMin<qint64>(estimatedRows, INT_MAX / 2)));
+
+    // 同一条线的点连续出现，线号文本变化时才查线号表
+    int lastLineCode = -1;
+    const char *lastIdBegin = nullptr;
+    int lastIdLength = 0;
+
+    // 只切分到最后一个映射列，未映射的列只记录位置，不做转换
+    QVarLengthArray<FieldSpan, 64> columnSpans(plan.requiredFields);
+    FieldSpan fields[DatParsePlan::FieldCount];
+
+    int count = 0;
+    int unreportedRows = 0;
+    const char *reportedPos = begin;
+    const char *lineStart = begin;
+    while (lineStart < end) {
+        if (progress && unreportedRows >= ProgressRowInterval) {
+            progress->rowsProcessed.fetchAndAddRelaxed(unreportedRows);
+            progress->bytesProcessed.fetchAndAddRelaxed(lineStart - reportedPos);
+            unreportedRows = 0;
+            reportedPos = lineStart;
+            if (progress->isCancelled())
+                return count;
+        }
+
+        const char *lineEnd = findLineEnd(lineStart, end);
+        if (splitRow(lineStart, lineEnd, plan, columnSpans.data(), fields)) {
+            const FieldSpan &id = fields[DatParsePlan::LineId];
+            if (!lastIdBegin || id.length() != lastIdLength
+                    || memcmp(id.begin, lastIdBegin, size_t(lastIdLength)) != 0) {
+                lastLineCode = points.internLine(QString::fromUtf8(id.begin, id.length()));
+            }
+            lastIdBegin = id.begin;
+            lastIdLength = id.length();
+
+            const FieldSpan &fn = fields[DatParsePlan::Fn];
+            const FieldSpan &x = fields[DatParsePlan::X];
+            const FieldSpan &y = fields[DatParsePlan::Y];
+            const FieldSpan &alt = fields[DatParsePlan::Alt];
+            const int fnValue = NumParse::toInt(fn.begin, fn.end);
+            points.append(lastLineCode, fnValue,
+                          NumParse::toDouble(x.begin, x.end), NumParse::toDouble(y.begin, y.end),
+                          NumParse::toDouble(alt.begin, alt.end));
+            if (rowOffsets)
+                rowOffsets->append(lineStart - begin);
+            if (rowKeys)
+                rowKeys->append(rowKeyHash(id, fnValue));
+            ++count;
+            ++unreportedRows;
+        }
+        lineStart = lineEnd + 1;
+    }
+
+    if (progress) {
+        progress->rowsProcessed.fetchAndAddRelaxed(unreportedRows);
+        progress->bytesProcessed.fetchAndAddRelaxed(end - reportedPos);
+    }
+    return count;
+}
+
+qint64 DatReader::countNewlines(const char *begin, const char *end)
+{
+    qint64 count = 0;
+    const char *p = begin;
+#ifdef DATREADER_HAVE_SSE2
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i zero = _mm_setzero_si128();
+    while (end - p >= 16) {
+        // 每个字节通道累加比较结果，最多255次后用SAD横向求和，避免通道溢出
+        __m128i lanes = _mm_setzero_si128();
+        const qint64 blocks = qMin<qint64>((end - p) / 16, 255);
+        for (qint64 i = 0; i < blocks; ++i, p += 16) {
+            __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            lanes = _mm_sub_epi8(lanes, _mm_cmpeq_epi8(bytes, newline));
+        }
+        __m128i sums = _mm_sad_epu8(lanes, zero);
+        count += _mm_cvtsi128_si32(sums) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(sums, sums));
+    }
+#endif
+    for (; p < end; ++p)
+        count += (*p == '\n');
+    return count;
+}
+
+int DatReader::parseRowsParallel(const char *begin, const char *end, const DatParsePlan &plan,
+                                 PointStore &points, ParseProgress *progress,
+                                 QVector<qint64> *rowOffsets, QVector<quint64> *rowKeys,
+                                 QThreadPool *pool)
+{
+    const qint64 length = end - begin;
+    const int maxChunks = pool ? qMax(1, pool->maxThreadCount()) : 1;
+    const int chunkCount = int(qBound<qint64>(1, length / MinChunkBytes, maxChunks));
+    if (chunkCount <= 1)
+        return parseRows(begin, end, plan, points, progress, rowOffsets, rowKeys);
+
+    // 分块边界对齐到换行符之后，保证每行完整落在某一块中
+    QVector<const char *> bounds;
+    bounds.reserve(chunkCount + 1);
+    bounds.append(begin);
+    for (int i = 1; i < chunkCount; ++i) {
+        const char *target = begin + length * i / chunkCount;
+        target = qMax(target, bounds.last());
+        const char *lineEnd = findLineEnd(target, end);
+        bounds.append(lineEnd < end ? lineEnd + 1 : end);
+    }
+    bounds.append(end);
+
+    QVector<PointStore> chunkPoints(chunkCount);
+    QVector<int> chunkCounts(chunkCount, 0);
+    QVector<QVector<qint64>> chunkOffsets(rowOffsets ? chunkCount : 0);
+    QVector<QVector<quint64>> chunkKeys(rowKeys ? chunkCount : 0);
+    QSemaphore done;
+
+    // 第0块由当前线程解析，其余块交给线程池
+    for (int i = 1; i < chunkCount; ++i) {
+        pool->start(new ParseChunkTask(bounds[i], bounds[i + 1], &plan, &chunkPoints[i],
+                                       &chunkCounts[i], progress,
+                                       rowOffsets ? &chunkOffsets[i] : nullptr,
+                                       rowKeys ? &chunkKeys[i] : nullptr, &done));
+    }
+    chunkCounts[0] = parseRows(bounds[0], bounds[1], plan, chunkPoints[0], progress,
+                               rowOffsets ? &chunkOffsets[0] : nullptr,
+                               rowKeys ? &chunkKeys[0] : nullptr);
+    done.acquire(chunkCount - 1);
+    if (progress && progress->isCancelled())
+        return 0;
+
+    // 按原始顺序拼接
+    int total = 0;
+    for (int count : chunkCounts)
+        total += count;
+    points.reserve(points.size() + total);
+    for (const PointStore &chunk : chunkPoints)
+        points.append(chunk);
+
+    // 各块的行偏移相对于块起点，换算为相对于begin
+    if (rowOffsets) {
+        rowOffsets->reserve(rowOffsets->size() + total);
+        for (int i = 0; i < chunkCount; ++i) {
+            const qint64 chunkBase = bounds[i] - begin;
+            for (qint64 offset : chunkOffsets[i])
+                rowOffsets->append(chunkBase + offset);
+        }
+    }
+    if (rowKeys) {
+        rowKeys->reserve(rowKeys->size() + total);
+        for (const QVector<quint64> &keys : chunkKeys)
+            rowKeys->append(keys);
+    }
+
+    return total;
+}
+
+int KeyFingerprint::firstDifferentBlock(const KeyFingerprint &other) const
+{
+    const int blocks = qMin(blockHashes.size(), other.blockHashes.size());
+    for (int b = 0; b < blocks; ++b) {
+        if (blockHashes[b] != other.blockHashes[b])
+            return b;
+    }
+    return -1;
+}
+
+DatReader::KeyFingerprinter::KeyFingerprinter(const DatParsePlan &plan, QVector<qint64> *rowOffsets)
+    : m_plan(plan)
+    , m_rowOffsets(rowOffsets)
+    , m_blockHash(0)
+    , m_blockRows(0)
+{
+    m_result.rows = 0;
+}
+
+bool DatReader::KeyFingerprinter::addRows(const char *begin, const char *end, qint64 offset,
+                                          ParseProgress *progress)
+{
+    QVarLengthArray<FieldSpan, 64> columnSpans(m_plan.requiredFields);
+    FieldSpan fields[DatParsePlan::FieldCount];
+
+    int unreportedRows = 0;
+    const char *reportedPos = begin;
+    const char *lineStart = begin;
+    while (lineStart < end) {
+        if (progress && unreportedRows >= ProgressRowInterval) {
+            progress->rowsProcessed.fetchAndAddRelaxed(unreportedRows);
+            progress->bytesProcessed.fetchAndAddRelaxed(lineStart - reportedPos);
+            unreportedRows = 0;
+            reportedPos = lineStart;
+            if (progress->isCancelled())
+                return false;
+        }
+
+        // 与parseRows判断数据行的条件一致，指纹中的第N行就是解析出的第N个点
+        const char *lineEnd = findLineEnd(lineStart, end);
+        if (splitRow(lineStart, lineEnd, m_plan, columnSpans.data(), fields)) {
+            const FieldSpan &fn = fields[DatParsePlan::Fn];
+            addRowKey(rowKeyHash(fields[DatParsePlan::LineId], NumParse::toInt(fn.begin, fn.end)));
+            if (m_rowOffsets)
+                m_rowOffsets->append(offset + (lineStart - begin));
+            ++unreportedRows;
+        }
+        lineStart = lineEnd + 1;
+    }
+
+    if (progress) {
+        progress->rowsProcessed.fetchAndAddRelaxed(unreportedRows);
+        progress->bytesProcessed.fetchAndAddRelaxed(end - reportedPos);
+    }
+    return true;
+}
+
+void DatReader::KeyFingerprinter::addRowKey(quint64 rowKey)
+{
+    m_blockHash = chainHash(m_blockHash, rowKey);
+    if (++m_blockRows == KeyFingerprint::BlockRows) {
+        m_result.blockHashes.append(m_blockHash);
+        m_blockHash = 0;
+        m_blockRows = 0;
+    }
+    ++m_result.rows;
+}
+
+KeyFingerprint DatReader::KeyFingerprinter::finish()
+{
+    if (m_blockRows > 0) {
+        m_result.blockHashes.append(m_blockHash);
+        m_blockHash = 0;
+        m_blockRows = 0;
+    }
+    return m_result;
+}
+
+QVector<quint64> DatReader::keyRowHashes(const char *begin, const char *end, const DatParsePlan &plan)
+{
+    QVector<quint64> hashes;
+    QVarLengthArray<FieldSpan, 64> columnSpans(plan.requiredFields);
+    FieldSpan fields[DatParsePlan::FieldCount];
+
+    const char *lineStart = begin;
+    while (lineStart < end) {
+        const char *lineEnd = findLineEnd(lineStart, end);
+        if (splitRow(lineStart, lineEnd, plan, columnSpans.data(), fields)) {
+            const FieldSpan &fn = fields[DatParsePlan::Fn];
+            hashes.append(rowKeyHash(fields[DatParsePlan::LineId], NumParse::toInt(fn.begin, fn.end)));
+        }
+        lineStart = lineEnd + 1;
+    }
+    return hashes;
+}
+
+DatLayout::DatLayout()
+    : fileSize(-1)
+    , lastModified(0)
+    , headerOffset(-1)
+    , bodyOffset(-1)
+    , bodyEnd(-1)
+    , headerLine(0)
+    , delimiter(' ')
+    , columnCount(0)
+    , rows(-1)
+{
+}
+
+bool DatLayout::readHeader(const char *begin, const char *end)
+{
+    const char *header = DatReader::findHeaderLine(begin, end);
+    if (!header)
+        return false;
+    const char *lineEnd = static_cast<const char *>(memchr(header, '\n', size_t(end - header)));
+    if (!lineEnd)
+        return false;
+
+    headerOffset = header - begin;
+    bodyOffset = lineEnd + 1 - begin;
+    headerLine = int(qMin<qint64>(DatReader::countNewlines(begin, header), INT_MAX));
+    delimiter = memchr(header, '\t', size_t(lineEnd - header)) ? '\t' : ' ';
+    headerColumns = DatReader::splitFields(header, lineEnd);
+    columnCount = headerColumns.size();
+    return true;
+}
@@ -0,0 +1,201 @@
+#ifndef DATREADER_H
+#define DATREADER_H
+
+#include <QAtomicInteger>
+#include <QFile>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+#include <QVector>
+#include "datastructures.h"
+
+// 内存映射方式读取的DAT文件
+// 直接在映射的原始字节上切分字段，不为每行、每个字段构造QString
+class MappedDatFile
+{
+public:
+    explicit MappedDatFile(const QString &filePath);
+    ~MappedDatFile();
+
+    // 打开并映射文件，同时定位表头（以LINE开头的行）
+    bool open();
+    void close();
+
+    QString filePath() const { return m_file.fileName(); }
+    const char *data() const { return m_data; }
+    qint64 size() const { return m_size; }
+
+    // 数据区起始字节偏移（表头LINE行的下一行），未找到表头时为-1
+    qint64 bodyOffset() const { return m_bodyOffset; }
+    bool hasBody() const { return m_bodyOffset >= 0; }
+
+    const char *bodyBegin() const { return m_data + m_bodyOffset; }
+    const char *bodyEnd() const { return m_data + m_size; }
+
+    // 表头LINE行的各列名
+    QStringList headerColumns() const;
+
+private:
+    QFile m_file;
+    uchar *m_map;
+    const char *m_data;
+    qint64 m_size;
+    qint64 m_headerOffset;
+    qint64 m_bodyOffset;
+
+    void findHeader();
+
+    Q_DISABLE_COPY(MappedDatFile)
+};
+
+// 解析计划：由列映射和检测到的表头构建一次，逐行解析时不再判断列位置
+struct DatParsePlan {
+    enum Field { LineId = 0, Fn, X, Y, Alt, FieldCount };
+
+    int columns[FieldCount];        // 各字段所在列
+    int requiredFields;             // 数据行至少应有的字段数（最大映射列+1），之后的列不再切分
+
+    // 定宽文件的快速路径：每行字节数相同，字段落在固定的字节区间内
+    bool fixedWidth;
+    int rowStride;                  // 含换行符的行字节数
+    int slotBegin[FieldCount];
+    int slotEnd[FieldCount];
+
+    // 缺省计划与原有格式一致：LINE FN _ _ X Y _ RALT
+    DatParsePlan();
+
+    // 由列映射、文件表头和样本行构建解析计划
+    // 映射无效时按表头列名匹配（LINE/FN/X/Y/RALT），再退回缺省列
+    static DatParsePlan build(const MappedDatFile &file, const ColumnMapping &mapping = ColumnMapping());
+
+    // 流式读取时没有整个文件的映射，用表头各列名和数据区开头的样本行构建
+    static DatParsePlan build(const QStringList &header, const char *sampleBegin, const char *sampleEnd,
+                              const ColumnMapping &mapping = ColumnMapping());
+
+private:
+    void setColumns(const int (&cols)[FieldCount]);
+    void detectFixedWidth(const char *begin, const char *end);
+};
+
+// 数据行主键（LINE、FN两列）的指纹，用于确认同一架次的多个文件逐行对应
+// 每BlockRows个数据行计算一个块哈希，比较时先找出第一个不同的块，再回到文件中逐行比较该块
+struct KeyFingerprint {
+    enum { BlockRows = 4096 };
+
+    qint64 rows;                    // 数据行数，-1表示尚未计算
+    QVector<quint64> blockHashes;
+
+    KeyFingerprint() : rows(-1) {}
+
+    bool isValid() const { return rows >= 0; }
+
+    // 两者都有的块中第一个哈希不同的块，都相同时返回-1
+    int firstDifferentBlock(const KeyFingerprint &other) const;
+};
+
+// DAT文件的布局：表头位置、分隔符、列数、数据行数、各数据行的偏移和主键指纹
+// 由一次完整读取得到，同一文件的预览、解析、校验和导出共用，不再各自识别表头和计数
+// 偏移均相对于文件开头，gzip文件为解压后的偏移
+struct DatLayout {
+    qint64 fileSize;
+    qint64 lastModified;            // 修改时间（毫秒时间戳），与fileSize一起判断缓存是否有效
+
+    qint64 headerOffset;            // 表头LINE行的偏移，-1表示没有表头
+    qint64 bodyOffset;              // 数据区起点（表头的下一行）
+    qint64 bodyEnd;                 // 数据区终点
+    int headerLine;                 // 表头之前的行数
+    char delimiter;                 // 表头中的字段分隔符，空格或制表符
+    int columnCount;
+    QStringList headerColumns;
+
+    ColumnMapping mapping;          // 扫描时使用的列映射
+    DatParsePlan plan;
+    qint64 rows;                    // 数据行数，-1表示只读取了表头
+    QVector<qint64> rowOffsets;     // 各数据行行首的偏移
+    KeyFingerprint keys;
+
+    DatLayout();
+
+    bool hasHeader() const { return headerOffset >= 0; }
+    bool isScanned() const { return rows >= 0; }
+    bool hasRowOffsets() const { return isScanned() && rowOffsets.size() == rows; }
+
+    // 在文件开头的[begin, end)中识别表头，表头行不完整或未找到时返回false
+    bool readHeader(const char *begin, const char *end);
+};
+
+namespace DatReader {
+
+// 字段分隔符（空格、制表符、回车）
+inline bool isSeparator(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+// 解析进度与取消标志，可被多个解析线程同时更新
+struct ParseProgress {
+    QAtomicInteger<qint64> bytesProcessed;
+    QAtomicInt rowsProcessed;
+    QAtomicInt cancelled;
+
+    ParseProgress() : bytesProcessed(0), rowsProcessed(0), cancelled(0) {}
+
+    void cancel() { cancelled.storeRelease(1); }
+    bool isCancelled() const { return cancelled.loadAcquire() != 0; }
+};
+
+// 在[begin, end)中查找首个以LINE开头的表头行（跳过开头的BOM），返回行首，未找到时返回nullptr
+const char *findHeaderLine(const char *begin, const char *end);
+
+// 将一行切分为各字段文本
+QStringList splitFields(const char *begin, const char *end);
+
+// 按解析计划解析[begin, end)范围内的数据行，追加到points，返回解析出的点数
+// 字段数不少于plan.requiredFields的行才视为数据行
+// progress非空时定期累加进度，被取消时提前返回（此时结果不完整）
+// rowOffsets非空时同时追加每个点所在行相对于begin的字节偏移
+// rowKeys非空时同时追加每个点的主键哈希，按线号的原始字节计算，与KeyFingerprinter一致
+int parseRows(const char *begin, const char *end, const DatParsePlan &plan,
+              PointStore &points, ParseProgress *progress = nullptr,
+              QVector<qint64> *rowOffsets = nullptr, QVector<quint64> *rowKeys = nullptr);
+
+// 统计[begin, end)中换行符的个数，使用SIMD每次比较16字节
+qint64 countNewlines(const char *begin, const char *end);
+
+// 逐段计算数据区的主键指纹，只读取一遍，同时统计数据行数
+// 数据可分多次送入，除最后一次外每次都须以完整的行结束
+class KeyFingerprinter
+{
+public:
+    // rowOffsets非空时同时追加每个数据行行首在文件中的字节偏移
+    explicit KeyFingerprinter(const DatParsePlan &plan, QVector<qint64> *rowOffsets = nullptr);
+
+    // offset为begin在文件中的字节偏移，被取消时返回false
+    bool addRows(const char *begin, const char *end, qint64 offset, ParseProgress *progress = nullptr);
+    // 送入parseRows已算出的一行主键哈希
+    void addRowKey(quint64 rowKey);
+    KeyFingerprint finish();
+
+    qint64 rows() const { return m_result.rows; }
+
+private:
+    DatParsePlan m_plan;
+    QVector<qint64> *m_rowOffsets;
+    KeyFingerprint m_result;
+    quint64 m_blockHash;
+    int m_blockRows;
+};
+
+// [begin, end)中各数据行的主键哈希，用于在指纹不同的块中找出第一个不同的行
+QVector<quint64> keyRowHashes(const char *begin, const char *end, const DatParsePlan &plan);
+
+// 将数据区按换行对齐切分为若干块，在线程池中并行解析，再按原始行顺序拼接
+// 结果与parseRows完全一致，数据量较小时直接单线程解析
+int parseRowsParallel(const char *begin, const char *end, const DatParsePlan &plan,
+                      PointStore &points, ParseProgress *progress = nullptr,
+                      QVector<qint64> *rowOffsets = nullptr, QVector<quint64> *rowKeys = nullptr,
+                      QThreadPool *pool = QThreadPool::globalInstance());
+
+}
+
+#endif // DATREADER_H
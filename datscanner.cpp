@@ -0,0 +1,369 @@
+#include "datscanner.h"
+#include "gzipreader.h"
+#include <QByteArray>
+#include <QDateTime>
+#include <QDebug>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QScopedPointer>
+#include <QSemaphore>
+#include <QThreadPool>
+#include <climits>
+#include <cstring>
+
+namespace {
+
+// 读取表头时每次读取的字节数，以及最多读取的字节数
+const qint64 HeaderChunkBytes = 64 * 1024;
+const qint64 MaxHeaderBytes = 16 * 1024 * 1024;
+
+// 缓存中各数据行偏移最多占用的字节数
+const qint64 MaxRowOffsetBytes = 256 * 1024 * 1024;
+
+// 扫描单个文件的任务，完成后释放信号量
+class ScanTask : public QRunnable
+{
+public:
+    ScanTask(const QString &filePath, const ColumnMapping &mapping, DatLayout *layout,
+             DatReader::ParseProgress *progress, QSemaphore *done)
+        : m_filePath(filePath), m_mapping(mapping), m_layout(layout)
+        , m_progress(progress), m_done(done) {}
+
+    void run() override
+    {
+        if (!DatScanner::instance().scan(m_filePath, m_mapping, *m_layout, m_progress)) {
+            *m_layout = DatLayout();
+            if (!m_progress || !m_progress->isCancelled())
+                qWarning() << "无法扫描文件:" << m_filePath;
+        }
+        if (m_done)
+            m_done->release();
+    }
+
+private:
+    QString m_filePath;
+    ColumnMapping m_mapping;
+    DatLayout *m_layout;
+    DatReader::ParseProgress *m_progress;
+    QSemaphore *m_done;
+};
+
+// 读回第block块数据行的原始字节，逐行计算主键哈希
+QVector<quint64> blockRowHashes(const QString &filePath, const DatLayout &layout, int block)
+{
+    const qint64 first = qint64(block) * KeyFingerprint::BlockRows;
+    const qint64 last = qMin(first + KeyFingerprint::BlockRows, layout.rows);
+    if (first >= last || !layout.hasRowOffsets())
+        return QVector<quint64>();
+
+    const qint64 begin = layout.rowOffsets[int(first)];
+    const qint64 end = (last < layout.rows) ? layout.rowOffsets[int(last)] : layout.bodyEnd;
+
+    // gzip文件只能从头解压，跳过前面的数据
+    QScopedPointer<QIODevice> device(createDatDevice(filePath));
+    if (!device->open(QIODevice::ReadOnly) || device->skip(begin) != begin)
+        return QVector<quint64>();
+    const QByteArray bytes = device->read(end - begin);
+    return DatReader::keyRowHashes(bytes.constData(), bytes.constData() + bytes.size(), layout.plan);
+}
+
+}
+
+DatScanner &DatScanner::instance()
+{
+    static DatScanner scanner;
+    return scanner;
+}
+
+QString DatScanner::cacheKey(const QString &filePath)
+{
+    return QFileInfo(filePath).absoluteFilePath();
+}
+
+bool DatScanner::isCurrent(const QString &filePath, const DatLayout &layout)
+{
+    QFileInfo fileInfo(filePath);
+    return layout.fileSize == fileInfo.size()
+            && layout.lastModified == fileInfo.lastModified().toMSecsSinceEpoch();
+}
+
+DatLayout DatScanner::header(const QString &filePath)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        auto it = m_layouts.constFind(cacheKey(filePath));
+        if (it != m_layouts.constEnd() && isCurrent(filePath, *it))
+            return *it;
+    }
+
+    DatLayout layout;
+    QFileInfo fileInfo(filePath);
+    QScopedPointer<QIODevice> device(createDatDevice(filePath));
+    if (!device->open(QIODevice::ReadOnly))
+        return layout;
+
+    // 表头通常在文件开头几行，读到完整的表头行为止
+    QByteArray head;
+    while (head.size() < MaxHeaderBytes) {
+        const QByteArray chunk = device->read(HeaderChunkBytes);
+        if (chunk.isEmpty())
+            break;
+        head.append(chunk);
+        if (layout.readHeader(head.constData(), head.constData() + head.size()))
+            break;
+    }
+
+    layout.fileSize = fileInfo.size();
+    layout.lastModified = fileInfo.lastModified().toMSecsSinceEpoch();
+
+    // 读取期间其他线程可能已完成完整扫描，不用表头结果覆盖
+    QMutexLocker locker(&m_mutex);
+    auto it = m_layouts.constFind(cacheKey(filePath));
+    if (it != m_layouts.constEnd() && isCurrent(filePath, *it))
+        return *it;
+    m_layouts.insert(cacheKey(filePath), layout);
+    m_offsetOrder.removeAll(cacheKey(filePath));
+    return layout;
+}
+
+bool DatScanner::scan(const QString &filePath, const ColumnMapping &mapping, DatLayout &layout,
+                      DatReader::ParseProgress *progress, bool needRowOffsets)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        auto it = m_layouts.constFind(cacheKey(filePath));
+        if (it != m_layouts.constEnd() && isCurrent(filePath, *it) && it->isScanned()
+                && it->mapping == mapping && (!needRowOffsets || it->hasRowOffsets())) {
+            layout = *it;
+            return true;
+        }
+    }
+
+    // 先记下文件大小和修改时间，扫描期间文件被改动时下次会重新扫描
+    QFileInfo fileInfo(filePath);
+    DatLayout scanned;
+    scanned.fileSize = fileInfo.size();
+    scanned.lastModified = fileInfo.lastModified().toMSecsSinceEpoch();
+    if (!scanFile(filePath, mapping, scanned, progress))
+        return false;
+
+    store(filePath, scanned);
+    layout = scanned;
+    return true;
+}
+
+bool DatScanner::scanFile(const QString &filePath, const ColumnMapping &mapping, DatLayout &layout,
+                          DatReader::ParseProgress *progress)
+{
+    if (isGzipFile(filePath)) {
+        const qint64 fileSize = layout.fileSize;
+        const qint64 lastModified = layout.lastModified;
+        if (!GzipDat::scan(filePath, mapping, layout, progress))
+            return false;
+        layout.fileSize = fileSize;
+        layout.lastModified = lastModified;
+        return true;
+    }
+
+    MappedDatFile datFile(filePath);
+    if (!datFile.open())
+        return false;
+
+    layout.mapping = mapping;
+    layout.bodyEnd = datFile.size();
+    if (!datFile.hasBody() || !layout.readHeader(datFile.data(), datFile.bodyEnd())) {
+        // 没有LINE表头时没有数据行
+        layout.rows = 0;
+        layout.keys.rows = 0;
+        return true;
+    }
+
+    if (progress)
+        progress->bytesProcessed.fetchAndAddRelaxed(datFile.bodyOffset());
+    layout.plan = DatParsePlan::build(datFile, mapping);
+    DatReader::KeyFingerprinter fingerprinter(layout.plan, &layout.rowOffsets);
+    if (!fingerprinter.addRows(datFile.bodyBegin(), datFile.bodyEnd(), datFile.bodyOffset(), progress))
+        return false;
+    layout.keys = fingerprinter.finish();
+    layout.rows = layout.keys.rows;
+    return true;
+}
+
+bool DatScanner::scanAll(const QStringList &filePaths, const ColumnMapping &mapping,
+                         QVector<DatLayout> &layouts, DatReader::ParseProgress *progress)
+{
+    layouts.fill(DatLayout(), filePaths.size());
+    if (filePaths.isEmpty())
+        return true;
+
+    // 第0个文件由当前线程扫描，其余交给线程池；已缓存的文件直接取缓存
+    QSemaphore done;
+    for (int i = 1; i < filePaths.size(); ++i) {
+        QThreadPool::globalInstance()->start(
+                    new ScanTask(filePaths[i], mapping, &layouts[i], progress, &done));
+    }
+    ScanTask(filePaths[0], mapping, &layouts[0], progress, nullptr).run();
+    done.acquire(filePaths.size() - 1);
+
+    return !(progress && progress->isCancelled());
+}
+
+DatLayout DatScanner::cached(const QString &filePath) const
+{
+    QMutexLocker locker(&m_mutex);
+    auto it = m_layouts.constFind(cacheKey(filePath));
+    if (it == m_layouts.constEnd() || !isCurrent(filePath, *it))
+        return DatLayout();
+    return *it;
+}
+
+void DatScanner::store(const QString &filePath, const DatLayout &layout)
+{
+    DatLayout stamped = layout;
+    if (stamped.fileSize < 0) {
+        QFileInfo fileInfo(filePath);
+        stamped.fileSize = fileInfo.size();
+        stamped.lastModified = fileInfo.lastModified().toMSecsSinceEpoch();
+    }
+
+    const QString key = cacheKey(filePath);
+    QMutexLocker locker(&m_mutex);
+    m_layouts.insert(key, stamped);
+    m_offsetOrder.removeAll(key);
+    if (!stamped.rowOffsets.isEmpty()) {
+        m_offsetOrder.append(key);
+        trimRowOffsets();
+    }
+}
+
+void DatScanner::trimRowOffsets()
+{
+    qint64 total = 0;
+    for (const QString &key : m_offsetOrder) {
+        auto it = m_layouts.constFind(key);
+        if (it != m_layouts.constEnd())
+            total += qint64(it->rowOffsets.size()) * qint64(sizeof(qint64));
+    }
+
+    // 最后存入的文件即使单独超出上限也保留，刚扫描完的调用方马上要用
+    while (total > MaxRowOffsetBytes && m_offsetOrder.size() > 1) {
+        auto it = m_layouts.find(m_offsetOrder.takeFirst());
+        if (it == m_layouts.end())
+            continue;
+        total -= qint64(it->rowOffsets.size()) * qint64(sizeof(qint64));
+        it->rowOffsets = QVector<qint64>();
+    }
+}
+
+void DatScanner::release(const QString &filePath)
+{
+    const QString key = cacheKey(filePath);
+    QMutexLocker locker(&m_mutex);
+    m_offsetOrder.removeAll(key);
+    auto it = m_layouts.find(key);
+    if (it != m_layouts.end())
+        it->rowOffsets = QVector<qint64>();
+}
+
+void DatScanner::releaseAll()
+{
+    QMutexLocker locker(&m_mutex);
+    for (const QString &key : m_offsetOrder) {
+        auto it = m_layouts.find(key);
+        if (it != m_layouts.end())
+            it->rowOffsets = QVector<qint64>();
+    }
+    m_offsetOrder.clear();
+}
+
+qint64 DatScanner::firstDivergingRow(const QString &referencePath, const DatLayout &reference,
+                                     const QString &filePath, const DatLayout &layout)
+{
+    if (!reference.isScanned() || !layout.isScanned())
+        return -1;
+
+    const int block = reference.keys.firstDifferentBlock(layout.keys);
+    if (block < 0) {
+        // 共有部分完全一致，较短的文件结束处即为第一个不对应的行
+        return reference.rows == layout.rows ? -1 : qMin(reference.rows, layout.rows);
+    }
+
+    // 从项目文件恢复的布局没有各行偏移，需要先补扫一遍
+    DatLayout referenceRows = reference;
+    DatLayout rows = layout;
+    if (!referenceRows.hasRowOffsets())
+        scan(referencePath, reference.mapping, referenceRows, nullptr, true);
+    if (!rows.hasRowOffsets())
+        scan(filePath, layout.mapping, rows, nullptr, true);
+
+    // 只读回两个文件中的这一块，逐行比较
+    const QVector<quint64> referenceHashes = blockRowHashes(referencePath, referenceRows, block);
+    const QVector<quint64> hashes = blockRowHashes(filePath, rows, block);
+    const int count = qMin(referenceHashes.size(), hashes.size());
+    int row = 0;
+    while (row < count && referenceHashes[row] == hashes[row])
+        ++row;
+    return qint64(block) * KeyFingerprint::BlockRows + row;
+}
+
+QJsonObject DatScanner::toJson(const QString &filePath) const
+{
+    const DatLayout layout = cached(filePath);
+    QJsonObject json;
+    if (!layout.isScanned())
+        return json;
+
+    json["fileSize"] = double(layout.fileSize);
+    json["lastModified"] = double(layout.lastModified);
+    json["headerOffset"] = double(layout.headerOffset);
+    json["bodyOffset"] = double(layout.bodyOffset);
+    json["bodyEnd"] = double(layout.bodyEnd);
+    json["headerLine"] = layout.headerLine;
+    json["delimiter"] = QString(QChar(layout.delimiter));
+    json["columns"] = QJsonArray::fromStringList(layout.headerColumns);
+    json["rows"] = double(layout.rows);
+
+    // 块哈希按本机字节序存为base64
+    const QByteArray blocks(reinterpret_cast<const char *>(layout.keys.blockHashes.constData()),
+                            layout.keys.blockHashes.size() * int(sizeof(quint64)));
+    json["keyBlocks"] = QString::fromLatin1(blocks.toBase64());
+    return json;
+}
+
+void DatScanner::restore(const QString &filePath, const QJsonObject &json, const ColumnMapping &mapping)
+{
+    DatLayout layout;
+    layout.fileSize = qint64(json["fileSize"].toDouble(-1));
+    layout.lastModified = qint64(json["lastModified"].toDouble());
+    layout.headerOffset = qint64(json["headerOffset"].toDouble(-1));
+    layout.bodyOffset = qint64(json["bodyOffset"].toDouble(-1));
+    layout.bodyEnd = qint64(json["bodyEnd"].toDouble(-1));
+    layout.headerLine = json["headerLine"].toInt();
+    layout.delimiter = json["delimiter"].toString() == "\t" ? '\t' : ' ';
+    for (const auto &column : json["columns"].toArray())
+        layout.headerColumns.append(column.toString());
+    layout.columnCount = layout.headerColumns.size();
+    layout.mapping = mapping;
+
+    const qint64 rows = qint64(json["rows"].toDouble(-1));
+    const QByteArray blocks = QByteArray::fromBase64(json["keyBlocks"].toString().toLatin1());
+    const qint64 blockCount = (rows + KeyFingerprint::BlockRows - 1) / KeyFingerprint::BlockRows;
+    if (rows < 0 || blocks.size() != blockCount * qint64(sizeof(quint64))) {
+        qDebug() << "忽略无效的扫描缓存:" << filePath;
+        return;
+    }
+    layout.keys.rows = rows;
+    layout.keys.blockHashes.resize(int(blockCount));
+    memcpy(layout.keys.blockHashes.data(), blocks.constData(), size_t(blocks.size()));
+    layout.rows = rows;
+
+    // 本次运行中已扫描过的结果更完整，不覆盖
+    QMutexLocker locker(&m_mutex);
+    auto it = m_layouts.constFind(cacheKey(filePath));
+    if (it != m_layouts.constEnd() && isCurrent(filePath, *it) && it->isScanned())
+        return;
+    m_layouts.insert(cacheKey(filePath), layout);
+    m_offsetOrder.removeAll(cacheKey(filePath));
+}
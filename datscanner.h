@@ -0,0 +1,72 @@
+#ifndef DATSCANNER_H
+#define DATSCANNER_H
+
+#include <QHash>
+#include <QJsonObject>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include "datastructures.h"
+#include "datreader.h"
+
+// 文件扫描服务：每个DAT文件在一次运行中只完整读取一遍，得到的布局按绝对路径缓存
+// 预览、导入、校验和导出都从这里取表头位置和各数据行偏移，不再各自读取文件
+// 文件大小或修改时间变化后缓存失效；可在多个线程中同时使用
+// 各数据行偏移每行8字节，总量超出上限时先释放最早存入的，行数和主键指纹一直保留
+class DatScanner
+{
+public:
+    static DatScanner &instance();
+
+    // 只读到表头为止，得到表头位置、分隔符和列数，已有缓存时不读文件
+    // 无法打开文件时返回的布局fileSize为-1
+    DatLayout header(const QString &filePath);
+
+    // 完整读取一遍，得到数据行数、各数据行偏移和主键指纹
+    // 缓存中已有按同一列映射扫描的结果时直接返回，包括从项目文件恢复的行数和指纹
+    // 要回读数据行时needRowOffsets为true，缓存中没有各数据行偏移时重新扫描
+    // 无法读取或被取消时返回false
+    bool scan(const QString &filePath, const ColumnMapping &mapping, DatLayout &layout,
+              DatReader::ParseProgress *progress = nullptr, bool needRowOffsets = false);
+
+    // 每个文件一个任务同时扫描，无法读取的文件对应未扫描的布局，被取消时返回false
+    bool scanAll(const QStringList &filePaths, const ColumnMapping &mapping, QVector<DatLayout> &layouts,
+                 DatReader::ParseProgress *progress = nullptr);
+
+    // 缓存中仍然有效的布局，没有时返回未扫描的布局
+    DatLayout cached(const QString &filePath) const;
+
+    // 解析首个文件时顺带得到的布局直接存入，不必再扫描一遍
+    void store(const QString &filePath, const DatLayout &layout);
+
+    // 文件移出架次或项目关闭后释放各数据行偏移，保留行数和主键指纹
+    void release(const QString &filePath);
+    void releaseAll();
+
+    // 与首个文件比较，返回第一个LINE/FN不对应的数据行（从0开始），逐行对应时返回-1
+    // 只回读第一个指纹不同的块，不再完整读取文件
+    qint64 firstDivergingRow(const QString &referencePath, const DatLayout &reference,
+                             const QString &filePath, const DatLayout &layout);
+
+    // 随项目保存的扫描结果，不含各数据行偏移；mapping为文件所在架次的列映射
+    QJsonObject toJson(const QString &filePath) const;
+    void restore(const QString &filePath, const QJsonObject &json, const ColumnMapping &mapping);
+
+private:
+    DatScanner() {}
+
+    static QString cacheKey(const QString &filePath);
+    static bool isCurrent(const QString &filePath, const DatLayout &layout);
+    static bool scanFile(const QString &filePath, const ColumnMapping &mapping, DatLayout &layout,
+                         DatReader::ParseProgress *progress);
+    void trimRowOffsets();
+
+    mutable QMutex m_mutex;
+    QHash<QString, DatLayout> m_layouts;    // 绝对路径 -> 布局
+    QStringList m_offsetOrder;              // 持有各数据行偏移的文件，先存入的在前
+
+    Q_DISABLE_COPY(DatScanner)
+};
+
+#endif // DATSCANNER_H
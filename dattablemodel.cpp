@@ -4,6 +4,7 @@
 DatTableModel::DatTableModel(QObject *parent)
     : QAbstractTableModel(parent)
     , m_datFileData(nullptr)
+    , m_rowCount(0)
 {
     initHeaders();
 
@@ -24,7 +25,7 @@ void DatTableModel::initHeaders()
 int DatTableModel::rowCount(const QModelIndex &parent) const
 {
     Q_UNUSED(parent)
-    return m_visibleRows.size();
+    return m_rowCount;
 }
 
 int DatTableModel::columnCount(const QModelIndex &parent) const
@@ -38,14 +39,16 @@ QVariant DatTableModel::data(const QModelIndex &index, int role) const
     if (!index.isValid() || !m_datFileData)
         return QVariant();
 
-    if (index.row() >= m_visibleRows.size())
+    if (index.row() >= m_rowCount)
         return QVariant();
 
-    int originalIndex = m_visibleRows[index.row()];
-    if (originalIndex >= m_datFileData->points.size())
+    // 表格行号即可见点的序号，由可见性位图的select换算
+    int originalIndex = m_datFileData->visibility().select(index.row());
+    if (originalIndex < 0)
         return QVariant();
 
-    const DataPoint &point = m_datFileData->points[originalIndex];
+    // 按行取点：架次压缩存放时（标签页在后台）经解码缓存读取，不展开整个架次
+    const DataPoint point = m_datFileData->pointAt(originalIndex);
 
     // 获取实际的列索引
     QVector<Column> visibleCols = getVisibleColumns();
@@ -78,7 +81,8 @@ QVariant DatTableModel::data(const QModelIndex &index, int role) const
     else if (role == Qt::BackgroundRole) {
         // 根据数据质量设置背景色
         if (actualColumn == Alt) {
-            if ((point.alt >= m_datFileData->lowAltThreshold) && (point.alt <= m_datFileData->highAltThreshold)) {
+            const double alt = point.alt;
+            if ((alt >= m_datFileData->lowAltThreshold) && (alt <= m_datFileData->highAltThreshold)) {
                 return QColor(200, 255, 200); // 淡绿色表示正常高度
             } else {
                 return QColor(255, 200, 200); // 淡红色表示异常高度
@@ -119,12 +123,22 @@ void DatTableModel::setBatchData(DataPointData *data)
 
 int DatTableModel::getOriginalIndex(int viewRow) const
 {
-    if (viewRow >= 0 && viewRow < m_visibleRows.size()) {
-        return m_visibleRows[viewRow];
+    if (m_datFileData && viewRow >= 0 && viewRow < m_rowCount) {
+        return m_datFileData->points.visibleIndex(viewRow);
     }
     return -1;
 }
 
+int DatTableModel::getViewRow(int originalIndex) const
+{
+    if (!m_datFileData || originalIndex < 0 || originalIndex >= m_datFileData->points.size()
+            || !m_datFileData->points.isVisible(originalIndex)) {
+        return -1;
+    }
+    int viewRow = m_datFileData->points.visibleRank(originalIndex);
+    return viewRow < m_rowCount ? viewRow : -1;
+}
+
 void DatTableModel::refreshVisibleRows()
 {
     beginResetModel();
@@ -133,6 +147,29 @@ void DatTableModel::refreshVisibleRows()
     emit dataChanged();
 }
 
+void DatTableModel::appendPoints(int first)
+{
+    if (!m_datFileData)
+        return;
+
+    // 新点都在末尾，first之前的可见点数就是新增的第一行
+    const PointStore &points = m_datFileData->points;
+    const int begin = points.visibleRank(first);
+    const int rows = points.visibleCount();
+    if (rows <= begin)
+        return;
+
+    // 表格行与first之前的点不一致时整体刷新
+    if (begin != m_rowCount) {
+        refreshVisibleRows();
+        return;
+    }
+
+    beginInsertRows(QModelIndex(), begin, rows - 1);
+    m_rowCount = rows;
+    endInsertRows();
+}
+
 bool DatTableModel::isColumnVisible(Column col) const
 {
     return m_visibleColumns.contains(col);
@@ -170,16 +207,8 @@ QVector<DatTableModel::Column> DatTableModel::getVisibleColumns() const
 
 void DatTableModel::updateVisibleRows()
 {
-    m_visibleRows.clear();
-
-    if (!m_datFileData)
-        return;
-
-    for (int i = 0; i < m_datFileData->points.size(); ++i) {
-        if (m_datFileData->points[i].isVisible) {
-            m_visibleRows.append(i);
-        }
-    }
+    // 行号与原始索引的换算由可见性位图完成，这里只更新行数
+    m_rowCount = m_datFileData ? m_datFileData->visibility().count() : 0;
 }
 
 void DatTableModel::setColumnMapping(const ColumnMapping &mapping)
@@ -35,9 +35,15 @@ public:
     // 获取原始数据索引（考虑到隐藏的行）
     int getOriginalIndex(int viewRow) const;
 
+    // 原始数据索引对应的表格行，该点被隐藏时返回-1
+    int getViewRow(int originalIndex) const;
+
     // 刷新可见行
     void refreshVisibleRows();
 
+    // 数据末尾追加了从first开始的点，只插入新增的行
+    void appendPoints(int first);
+
     // 获取列的可见性
     bool isColumnVisible(Column col) const;
 
@@ -61,7 +67,7 @@ signals:
 
 private:
     DataPointData *m_datFileData;
-    QVector<int> m_visibleRows;     // 可见行在原始数据中的索引
+    int m_rowCount;                 // 表格行数（可见点数），刷新时才更新，与视图保持一致
     QSet<Column> m_visibleColumns;  // 可见的列
     QStringList m_headers;
     ColumnMapping m_columnMapping;
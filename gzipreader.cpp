@@ -0,0 +1,445 @@
+#include "gzipreader.h"
+#include <QDebug>
+#include <QThread>
+#include <cstring>
+
+#ifdef Q_OS_WIN
+#include <QtZlib/zlib.h>    // Qt自带的zlib，由QtCore导出
+#else
+#include <zlib.h>
+#endif
+
+namespace {
+
+// 每次从文件读取的压缩数据大小
+const int InputBytes = 1024 * 1024;
+
+// 解压输出的块大小，以及队列中最多积压的块数
+const int BlockBytes = 4 * 1024 * 1024;
+const int MaxQueuedBlocks = 4;
+
+// 还没找到表头时最多保留这么多字节，超过后只保留最后一行未完整的部分
+const int MaxPendingHeaderBytes = 1024 * 1024;
+
+// 从reader逐块取出解压后的数据，先在layout中记下表头，之后只把完整的行交给onRows
+// 找到表头时以表头之后的数据为样本调用onHeader(sampleBegin, sampleEnd)
+// onRows(begin, end, offset)中offset为begin在解压后数据中的偏移
+// 读完返回true，出错或被取消时返回false
+template <typename HeaderHandler, typename RowsHandler>
+bool feedRows(GzipBlockReader &reader, DatLayout &layout, DatReader::ParseProgress *progress,
+              HeaderHandler onHeader, RowsHandler onRows)
+{
+    QByteArray buffer;          // 上一块末尾未完整的行加上新的一块
+    QByteArray block;
+    qint64 bufferOffset = 0;    // buffer开头在解压后数据中的偏移
+    int droppedLines = 0;       // 找到表头前已丢弃的行数
+    bool haveBody = false;
+    qint64 reportedBytes = 0;
+
+    while (reader.nextBlock(block)) {
+        if (buffer.isEmpty())
+            buffer = block;
+        else
+            buffer.append(block);
+
+        if (!haveBody) {
+            const char *begin = buffer.constData();
+            const char *end = begin + buffer.size();
+            if (!layout.readHeader(begin, end)) {
+                // 还没出现表头时丢弃已完整的行，避免无表头的文件占用大量内存
+                if (buffer.size() > MaxPendingHeaderBytes && !DatReader::findHeaderLine(begin, end)) {
+                    const int dropped = buffer.lastIndexOf('\n') + 1;
+                    droppedLines += int(DatReader::countNewlines(begin, begin + dropped));
+                    bufferOffset += dropped;
+                    buffer.remove(0, dropped);
+                }
+                continue;
+            }
+
+            const int bodyStart = int(layout.bodyOffset);
+            layout.headerOffset += bufferOffset;
+            layout.bodyOffset += bufferOffset;
+            layout.headerLine += droppedLines;
+            onHeader(begin + bodyStart, end);
+            buffer.remove(0, bodyStart);
+            bufferOffset += bodyStart;
+            haveBody = true;
+        }
+
+        const int complete = buffer.lastIndexOf('\n') + 1;
+        if (complete > 0) {
+            onRows(buffer.constData(), buffer.constData() + complete, bufferOffset);
+            buffer.remove(0, complete);
+            bufferOffset += complete;
+        }
+
+        if (progress) {
+            const qint64 bytesRead = reader.compressedBytesRead();
+            progress->bytesProcessed.fetchAndAddRelaxed(bytesRead - reportedBytes);
+            reportedBytes = bytesRead;
+            if (progress->isCancelled()) {
+                reader.cancel();
+                return false;
+            }
+        }
+    }
+    if (reader.hasError())
+        return false;
+
+    // 最后一行没有换行符
+    if (haveBody && !buffer.isEmpty())
+        onRows(buffer.constData(), buffer.constData() + buffer.size(), bufferOffset);
+    layout.bodyEnd = bufferOffset + buffer.size();
+    return true;
+}
+
+}
+
+// 执行GzipBlockReader::inflateAll的解压线程
+class GzipInflateThread : public QThread
+{
+public:
+    explicit GzipInflateThread(GzipBlockReader *reader) : m_reader(reader) {}
+
+protected:
+    void run() override { m_reader->inflateAll(); }
+
+private:
+    GzipBlockReader *m_reader;
+};
+
+bool isGzipFile(const QString &filePath)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    const QByteArray magic = file.read(2);
+    return magic.size() == 2 && uchar(magic[0]) == 0x1f && uchar(magic[1]) == 0x8b;
+}
+
+QIODevice *createDatDevice(const QString &filePath)
+{
+    if (isGzipFile(filePath))
+        return new GzipDevice(filePath);
+    return new QFile(filePath);
+}
+
+GzipBlockReader::GzipBlockReader(const QString &filePath)
+    : m_file(filePath)
+    , m_thread(new GzipInflateThread(this))
+    , m_finished(false)
+    , m_cancelled(0)
+    , m_error(0)
+    , m_bytesRead(0)
+{
+}
+
+GzipBlockReader::~GzipBlockReader()
+{
+    cancel();
+    m_thread->wait();
+    delete m_thread;
+}
+
+bool GzipBlockReader::start()
+{
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        qWarning() << "无法打开文件:" << m_file.fileName();
+        return false;
+    }
+    m_thread->start();
+    return true;
+}
+
+void GzipBlockReader::cancel()
+{
+    m_cancelled.storeRelease(1);
+    QMutexLocker locker(&m_mutex);
+    m_notEmpty.wakeAll();
+    m_notFull.wakeAll();
+}
+
+bool GzipBlockReader::nextBlock(QByteArray &block)
+{
+    QMutexLocker locker(&m_mutex);
+    while (m_queue.isEmpty() && !m_finished && !m_cancelled.loadAcquire())
+        m_notEmpty.wait(&m_mutex);
+    if (m_queue.isEmpty())
+        return false;
+
+    block = m_queue.dequeue();
+    m_notFull.wakeOne();
+    return true;
+}
+
+bool GzipBlockReader::pushBlock(const QByteArray &block)
+{
+    // 队列满时等待解析线程取走，解压不会跑在解析前面太多
+    QMutexLocker locker(&m_mutex);
+    while (m_queue.size() >= MaxQueuedBlocks && !m_cancelled.loadAcquire())
+        m_notFull.wait(&m_mutex);
+    if (m_cancelled.loadAcquire())
+        return false;
+
+    m_queue.enqueue(block);
+    m_notEmpty.wakeOne();
+    return true;
+}
+
+void GzipBlockReader::finish(bool error)
+{
+    if (error)
+        m_error.storeRelease(1);
+    QMutexLocker locker(&m_mutex);
+    m_finished = true;
+    m_notEmpty.wakeAll();
+}
+
+void GzipBlockReader::inflateAll()
+{
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    // 16 + MAX_WBITS：按gzip格式解码
+    if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK) {
+        qWarning() << "无法初始化解压:" << m_file.fileName();
+        finish(true);
+        return;
+    }
+
+    QByteArray input(InputBytes, Qt::Uninitialized);
+    QByteArray output(BlockBytes, Qt::Uninitialized);
+    int outputUsed = 0;
+    bool memberEnded = false;
+    int membersDone = 0;
+    bool error = false;
+
+    while (!m_cancelled.loadAcquire()) {
+        if (stream.avail_in == 0) {
+            const qint64 n = m_file.read(input.data(), input.size());
+            if (n < 0) {
+                error = true;
+                break;
+            }
+            if (n == 0) {
+                // 最后一个成员没有正常结束，文件被截断
+                error = !memberEnded;
+                break;
+            }
+            m_bytesRead.fetchAndAddRelaxed(n);
+            stream.next_in = reinterpret_cast<Bytef *>(input.data());
+            stream.avail_in = uInt(n);
+        }
+
+        // 多个gzip成员首尾相接时（如用cat拼接）继续解下一个成员
+        if (memberEnded) {
+            inflateReset(&stream);
+            memberEnded = false;
+        }
+
+        stream.next_out = reinterpret_cast<Bytef *>(output.data() + outputUsed);
+        stream.avail_out = uInt(output.size() - outputUsed);
+        const int ret = inflate(&stream, Z_NO_FLUSH);
+        outputUsed = output.size() - int(stream.avail_out);
+
+        if (ret == Z_STREAM_END) {
+            memberEnded = true;
+            ++membersDone;
+        } else if (ret == Z_DATA_ERROR && membersDone > 0 && stream.total_out == 0) {
+            // 最后一个成员之后的填充字节，忽略
+            break;
+        } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            qWarning() << "解压出错:" << m_file.fileName() << (stream.msg ? stream.msg : "");
+            error = true;
+            break;
+        }
+
+        if (outputUsed == output.size()) {
+            if (!pushBlock(output))
+                break;
+            output = QByteArray(BlockBytes, Qt::Uninitialized);
+            outputUsed = 0;
+        }
+    }
+
+    if (!error && outputUsed > 0 && !m_cancelled.loadAcquire()) {
+        output.resize(outputUsed);
+        pushBlock(output);
+    }
+    inflateEnd(&stream);
+    m_file.close();
+    finish(error);
+}
+
+GzipDevice::GzipDevice(const QString &filePath, QObject *parent)
+    : QIODevice(parent)
+    , m_filePath(filePath)
+    , m_blockPos(0)
+{
+}
+
+GzipDevice::~GzipDevice()
+{
+    close();
+}
+
+bool GzipDevice::open(OpenMode mode)
+{
+    if (mode & QIODevice::WriteOnly) {
+        setErrorString("gzip文件只支持读取");
+        return false;
+    }
+
+    m_reader.reset(new GzipBlockReader(m_filePath));
+    if (!m_reader->start()) {
+        m_reader.reset();
+        setErrorString("无法打开文件");
+        return false;
+    }
+    m_block.clear();
+    m_blockPos = 0;
+    if (!QIODevice::open(mode)) {
+        m_reader.reset();
+        return false;
+    }
+    fetchBlock();
+    return true;
+}
+
+void GzipDevice::close()
+{
+    QIODevice::close();
+    m_reader.reset();
+    m_block.clear();
+    m_blockPos = 0;
+}
+
+qint64 GzipDevice::bytesAvailable() const
+{
+    return (m_block.size() - m_blockPos) + QIODevice::bytesAvailable();
+}
+
+void GzipDevice::fetchBlock()
+{
+    m_blockPos = 0;
+    if (!m_reader || !m_reader->nextBlock(m_block))
+        m_block.clear();
+}
+
+qint64 GzipDevice::readData(char *data, qint64 maxSize)
+{
+    qint64 copied = 0;
+    while (copied < maxSize && m_blockPos < m_block.size()) {
+        const int n = int(qMin<qint64>(maxSize - copied, m_block.size() - m_blockPos));
+        memcpy(data + copied, m_block.constData() + m_blockPos, size_t(n));
+        copied += n;
+        m_blockPos += n;
+        if (m_blockPos == m_block.size())
+            fetchBlock();
+    }
+    // 已无数据可读
+    if (copied == 0)
+        return -1;
+    return copied;
+}
+
+qint64 GzipDevice::writeData(const char *data, qint64 maxSize)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(maxSize);
+    return -1;
+}
+
+int GzipDat::readPoints(const QString &filePath, const ColumnMapping &mapping,
+                        PointStore &points, DatReader::ParseProgress *progress, DatLayout *layout)
+{
+    GzipBlockReader reader(filePath);
+    if (!reader.start())
+        return -1;
+
+    DatLayout scanned;
+    QVector<qint64> *rowOffsets = layout ? &scanned.rowOffsets : nullptr;
+    QScopedPointer<DatReader::KeyFingerprinter> fingerprinter;
+    QVector<quint64> rowKeys;
+    int count = 0;
+    int reserved = 0;
+    const bool finished = feedRows(reader, scanned, progress,
+        [&](const char *sampleBegin, const char *sampleEnd) {
+            scanned.plan = DatParsePlan::build(scanned.headerColumns, sampleBegin, sampleEnd, mapping);
+            if (layout)
+                fingerprinter.reset(new DatReader::KeyFingerprinter(scanned.plan));
+        },
+        [&](const char *begin, const char *end, qint64 offset) {
+            // parseRows只按本块预留空间，逐块追加时先成倍预留，避免每块都重新分配
+            const char *firstLineEnd = static_cast<const char *>(memchr(begin, '\n', size_t(end - begin)));
+            const int estimated = int((end - begin) / ((firstLineEnd ? firstLineEnd : end) - begin + 1));
+            if (points.size() + estimated > reserved) {
+                reserved = qMax(reserved * 2, points.size() + estimated);
+                points.reserve(reserved);
+            }
+
+            const int offsetsBefore = rowOffsets ? rowOffsets->size() : 0;
+            // 主键哈希按线号的原始字节计算，逐块送入后即丢弃
+            rowKeys.clear();
+            const int parsed = DatReader::parseRows(begin, end, scanned.plan, points, nullptr, rowOffsets,
+                                                    fingerprinter ? &rowKeys : nullptr);
+            if (rowOffsets) {
+                for (int i = offsetsBefore; i < rowOffsets->size(); ++i)
+                    (*rowOffsets)[i] += offset;
+            }
+            for (quint64 rowKey : rowKeys)
+                fingerprinter->addRowKey(rowKey);
+            count += parsed;
+            if (progress)
+                progress->rowsProcessed.fetchAndAddRelaxed(parsed);
+        });
+
+    if (reader.hasError())
+        return -1;
+    if (finished && layout) {
+        scanned.mapping = mapping;
+        scanned.rows = count;
+        if (fingerprinter) {
+            scanned.keys = fingerprinter->finish();
+        } else {
+            // 没有LINE表头时没有数据行
+            scanned.keys.rows = 0;
+        }
+        *layout = scanned;
+    }
+    return count;
+}
+
+bool GzipDat::scan(const QString &filePath, const ColumnMapping &mapping, DatLayout &layout,
+                   DatReader::ParseProgress *progress)
+{
+    GzipBlockReader reader(filePath);
+    if (!reader.start())
+        return false;
+
+    DatLayout scanned;
+    QScopedPointer<DatReader::KeyFingerprinter> fingerprinter;
+    const bool finished = feedRows(reader, scanned, progress,
+        [&](const char *sampleBegin, const char *sampleEnd) {
+            scanned.plan = DatParsePlan::build(scanned.headerColumns, sampleBegin, sampleEnd, mapping);
+            fingerprinter.reset(new DatReader::KeyFingerprinter(scanned.plan, &scanned.rowOffsets));
+        },
+        [&](const char *begin, const char *end, qint64 offset) {
+            const qint64 rowsBefore = fingerprinter->rows();
+            fingerprinter->addRows(begin, end, offset);
+            if (progress)
+                progress->rowsProcessed.fetchAndAddRelaxed(int(fingerprinter->rows() - rowsBefore));
+        });
+    if (!finished || reader.hasError())
+        return false;
+
+    scanned.mapping = mapping;
+    if (fingerprinter) {
+        scanned.keys = fingerprinter->finish();
+    } else {
+        // 没有LINE表头时没有数据行
+        scanned.keys.rows = 0;
+    }
+    scanned.rows = scanned.keys.rows;
+    layout = scanned;
+    return true;
+}
@@ -0,0 +1,108 @@
+#ifndef GZIPREADER_H
+#define GZIPREADER_H
+
+#include <QAtomicInteger>
+#include <QByteArray>
+#include <QFile>
+#include <QIODevice>
+#include <QMutex>
+#include <QQueue>
+#include <QScopedPointer>
+#include <QString>
+#include <QWaitCondition>
+#include "datastructures.h"
+#include "datreader.h"
+
+class GzipInflateThread;
+
+// 按文件头魔数判断是否为gzip压缩文件
+bool isGzipFile(const QString &filePath);
+
+// 打开DAT文件供QTextStream逐行读取，gzip压缩文件边读边解压
+// 返回的设备尚未打开，由调用方open并负责释放
+QIODevice *createDatDevice(const QString &filePath);
+
+// gzip流式解压：后台线程把解压结果切成固定大小的块放入有界队列，
+// 解析线程逐块取出，解压和解析同时进行，内存占用与文件大小无关
+class GzipBlockReader
+{
+public:
+    explicit GzipBlockReader(const QString &filePath);
+    ~GzipBlockReader();
+
+    // 打开文件并启动解压线程
+    bool start();
+    void cancel();
+
+    // 阻塞等待下一块解压数据，全部读完、出错或被取消时返回false
+    bool nextBlock(QByteArray &block);
+
+    bool hasError() const { return m_error.load() != 0; }
+    qint64 compressedBytesRead() const { return m_bytesRead.load(); }
+
+private:
+    friend class GzipInflateThread;
+    void inflateAll();      // 在解压线程中执行
+    bool pushBlock(const QByteArray &block);
+    void finish(bool error);
+
+    QFile m_file;
+    GzipInflateThread *m_thread;
+
+    QMutex m_mutex;
+    QWaitCondition m_notEmpty;
+    QWaitCondition m_notFull;
+    QQueue<QByteArray> m_queue;
+    bool m_finished;
+
+    QAtomicInt m_cancelled;
+    QAtomicInt m_error;
+    QAtomicInteger<qint64> m_bytesRead;
+
+    Q_DISABLE_COPY(GzipBlockReader)
+};
+
+// 以只读顺序设备的方式读取gzip文件，用于预览和导出等逐行读取的场合
+class GzipDevice : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    explicit GzipDevice(const QString &filePath, QObject *parent = nullptr);
+    ~GzipDevice() override;
+
+    bool open(OpenMode mode) override;
+    void close() override;
+    bool isSequential() const override { return true; }
+    qint64 bytesAvailable() const override;
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 maxSize) override;
+
+private:
+    void fetchBlock();
+
+    QString m_filePath;
+    QScopedPointer<GzipBlockReader> m_reader;
+    QByteArray m_block;
+    int m_blockPos;
+};
+
+// 流式读取gzip压缩的DAT文件，结果与读取解压后的文件一致
+// progress中的字节数按压缩后的字节计，布局中的偏移为解压后的偏移
+namespace GzipDat {
+
+// 解析坐标点，返回点数，无法打开或解压出错时返回-1
+// layout非空时读完后同时给出文件布局（表头、各数据行偏移和主键指纹）
+int readPoints(const QString &filePath, const ColumnMapping &mapping,
+               PointStore &points, DatReader::ParseProgress *progress = nullptr,
+               DatLayout *layout = nullptr);
+
+// 完整读取一遍得到文件布局，无法打开、解压出错或被取消时返回false
+bool scan(const QString &filePath, const ColumnMapping &mapping, DatLayout &layout,
+          DatReader::ParseProgress *progress = nullptr);
+
+}
+
+#endif // GZIPREADER_H
@@ -0,0 +1,127 @@
+#include "importjob.h"
+#include "projectmodel.h"
+#include "datscanner.h"
+#include <QFileInfo>
+#include <QThread>
+#include <QTimer>
+#include <QDebug>
+#include <climits>
+
+// 执行ImportJob::run的工作线程
+class ImportThread : public QThread
+{
+public:
+    explicit ImportThread(ImportJob *job) : QThread(job), m_job(job) {}
+
+protected:
+    void run() override { m_job->run(); }
+
+private:
+    ImportJob *m_job;
+};
+
+ImportJob::ImportJob(const QString& batchName, const QString& filePath, Mode mode,
+                     const ColumnMapping& mapping, QObject *parent)
+    : QObject(parent)
+    , m_batchName(batchName)
+    , m_filePath(filePath)
+    , m_mode(mode)
+    , m_mapping(mapping)
+    , m_thread(new ImportThread(this))
+    , m_progressTimer(new QTimer(this))
+    , m_divergingRow(-1)
+    , m_rowCount(0)
+    , m_parsedEnd(-1)
+    , m_succeeded(false)
+    , m_bytesTotal(QFileInfo(filePath).size())
+{
+    // 进度由GUI线程定时读取，避免工作线程频繁发信号
+    m_progressTimer->setInterval(100);
+    connect(m_progressTimer, &QTimer::timeout, this, &ImportJob::reportProgress);
+    connect(m_thread, &QThread::finished, this, &ImportJob::onThreadFinished);
+}
+
+ImportJob::~ImportJob()
+{
+    cancel();
+    m_thread->wait();
+}
+
+void ImportJob::setReference(const QString& filePath)
+{
+    m_referencePath = filePath;
+    const DatLayout layout = DatScanner::instance().cached(filePath);
+    if (!layout.isScanned() || !(layout.mapping == m_mapping))
+        m_bytesTotal += QFileInfo(filePath).size();
+}
+
+void ImportJob::start()
+{
+    m_progressTimer->start();
+    m_thread->start();
+}
+
+void ImportJob::cancel()
+{
+    m_progress.cancel();
+}
+
+qint64 ImportJob::bytesProcessed() const
+{
+    return qMin(m_progress.bytesProcessed.load(), m_bytesTotal);
+}
+
+int ImportJob::rowsProcessed() const
+{
+    return m_progress.rowsProcessed.load();
+}
+
+PointStore ImportJob::takePoints()
+{
+    PointStore points;
+    qSwap(points, m_points);
+    return points;
+}
+
+void ImportJob::reportProgress()
+{
+    emit progressChanged(bytesProcessed(), m_bytesTotal, rowsProcessed());
+}
+
+void ImportJob::onThreadFinished()
+{
+    m_progressTimer->stop();
+    reportProgress();
+    emit finished();
+}
+
+void ImportJob::run()
+{
+    if (m_mode == ParsePoints) {
+        m_rowCount = ProjectModel::readDataPoints(m_filePath, m_mapping, m_points, &m_progress,
+                                                  &m_parsedEnd);
+        if (m_rowCount < 0) {
+            qWarning() << "无法打开文件:" << m_filePath;
+            return;
+        }
+    } else {
+        // 与首个文件同时扫描，每个文件只读一遍，既统计数据行数又计算主键指纹
+        // 扫描结果由DatScanner缓存，之后导出时不再重读
+        DatScanner& scanner = DatScanner::instance();
+        QStringList paths;
+        paths << m_filePath;
+        if (!m_referencePath.isEmpty())
+            paths << m_referencePath;
+        QVector<DatLayout> layouts;
+        if (!scanner.scanAll(paths, m_mapping, layouts, &m_progress))
+            return;
+        if (!layouts[0].isScanned())
+            return;
+        m_rowCount = int(qMin<qint64>(layouts[0].rows, INT_MAX));
+
+        // 首个文件无法读取时只校验行数
+        if (layouts.size() > 1)
+            m_divergingRow = scanner.firstDivergingRow(m_referencePath, layouts[1], m_filePath, layouts[0]);
+    }
+    m_succeeded = !m_progress.isCancelled();
+}
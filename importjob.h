@@ -0,0 +1,86 @@
+#ifndef IMPORTJOB_H
+#define IMPORTJOB_H
+
+#include <QObject>
+#include <QList>
+#include <QString>
+#include "datastructures.h"
+#include "datreader.h"
+
+class QTimer;
+class ImportThread;
+
+// 后台导入任务：在工作线程中解析架次首个文件，或校验后续文件的行数和LINE/FN
+// 结果只在任务结束后由GUI线程提交到架次，中途取消不会改动架次数据
+class ImportJob : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Mode {
+        ParsePoints,    // 解析坐标点（架次首个文件）
+        CountRows       // 统计行数并计算主键指纹，用于校验行数约束和记录是否逐行对应
+    };
+
+    // mapping为架次首个文件的列映射
+    ImportJob(const QString& batchName, const QString& filePath, Mode mode,
+              const ColumnMapping& mapping = ColumnMapping(), QObject *parent = nullptr);
+    ~ImportJob();
+
+    // CountRows模式下与之比较的架次首个文件，DatScanner中已有其扫描结果时不再重读
+    void setReference(const QString& filePath);
+
+    void start();
+    void cancel();
+
+    QString batchName() const { return m_batchName; }
+    QString filePath() const { return m_filePath; }
+    Mode mode() const { return m_mode; }
+    ColumnMapping columnMapping() const { return m_mapping; }
+
+    bool isCancelled() const { return m_progress.isCancelled(); }
+    bool succeeded() const { return m_succeeded; }
+
+    qint64 bytesProcessed() const;
+    qint64 bytesTotal() const { return m_bytesTotal; }
+    int rowsProcessed() const;
+
+    // 任务结束后取得结果
+    PointStore takePoints();
+    int rowCount() const { return m_rowCount; }
+    // ParsePoints模式下解析到的字节偏移，-1表示未知
+    qint64 parsedEnd() const { return m_parsedEnd; }
+    qint64 divergingRow() const { return m_divergingRow; }
+
+signals:
+    void progressChanged(qint64 bytesProcessed, qint64 bytesTotal, int rowsProcessed);
+    void finished();
+
+private slots:
+    void reportProgress();
+    void onThreadFinished();
+
+private:
+    friend class ImportThread;
+    void run();     // 在工作线程中执行
+
+    QString m_batchName;
+    QString m_filePath;
+    Mode m_mode;
+    ColumnMapping m_mapping;
+
+    ImportThread *m_thread;
+    QTimer *m_progressTimer;
+    DatReader::ParseProgress m_progress;
+
+    QString m_referencePath;
+    qint64 m_divergingRow;
+
+    PointStore m_points;
+    int m_rowCount;
+    qint64 m_parsedEnd;
+    bool m_succeeded;
+    qint64 m_bytesTotal;
+};
+
+#endif // IMPORTJOB_H
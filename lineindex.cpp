@@ -0,0 +1,87 @@
+#include "lineindex.h"
+#include <climits>
+
+void LineIndex::clear()
+{
+    m_runs.clear();
+    m_next.clear();
+    m_first.clear();
+    m_last.clear();
+    m_lines = 0;
+}
+
+void LineIndex::append(const int *codes, const int *fns, int first, int count)
+{
+    // 同一条线的点连续出现，每段只处理一次
+    int i = first;
+    while (i < count) {
+        const int code = codes[i];
+        int maxStep = INT_MIN;
+        int j = i + 1;
+        for (; j < count && codes[j] == code; ++j)
+            maxStep = qMax(maxStep, fns[j] - fns[j - 1]);
+
+        if (code >= m_first.size()) {
+            const int grow = code + 1 - m_first.size();
+            m_first.insert(m_first.size(), grow, -1);
+            m_last.insert(m_last.size(), grow, -1);
+        }
+
+        const int last = m_last.at(code);
+        if (last >= 0 && m_runs.at(last).end == i) {
+            LineRun &run = m_runs[last];
+            maxStep = qMax(maxStep, fns[i] - run.lastFn);
+            run.end = j;
+            run.lastFn = fns[j - 1];
+            run.maxFnStep = qMax(run.maxFnStep, maxStep);
+        } else {
+            const int r = m_runs.size();
+            m_runs.append(LineRun(i, j, fns[i], fns[j - 1], j - i > 1 ? maxStep : 0));
+            m_next.append(-1);
+            if (last >= 0)
+                m_next[last] = r;
+            else {
+                m_first[code] = r;
+                ++m_lines;
+            }
+            m_last[code] = r;
+        }
+        i = j;
+    }
+}
+
+void LineIndex::removeLast(int code, int lastFn)
+{
+    // 末尾的点总在最后一段中
+    const int last = (code >= 0 && code < m_last.size()) ? m_last.at(code) : -1;
+    if (last < 0 || last != m_runs.size() - 1)
+        return;
+
+    LineRun &run = m_runs[last];
+    if (--run.end > run.begin) {
+        run.lastFn = lastFn;
+        return;
+    }
+
+    // 段已空，从链中摘下；一条线通常只有几段，顺链查找前一段
+    int prev = -1;
+    for (int r = m_first.at(code); r != last; r = m_next.at(r))
+        prev = r;
+    if (prev >= 0) {
+        m_next[prev] = -1;
+    } else {
+        m_first[code] = -1;
+        --m_lines;
+    }
+    m_last[code] = prev;
+    m_runs.removeLast();
+    m_next.removeLast();
+}
+
+QVector<LineRun> LineIndex::runs(int code) const
+{
+    QVector<LineRun> result;
+    for (int r = firstRun(code); r >= 0; r = m_next.at(r))
+        result.append(m_runs.at(r));
+    return result;
+}
@@ -0,0 +1,58 @@
+#ifndef LINEINDEX_H
+#define LINEINDEX_H
+
+#include <QVector>
+
+// 一段线号相同、下标连续的点[begin, end)
+struct LineRun {
+    int begin;
+    int end;
+    int firstFn;        // 段首点号
+    int lastFn;         // 段末点号
+    int maxFnStep;      // 段内相邻两点点号之差的最大值（去掉末尾点后只作上界）
+
+    LineRun() : begin(0), end(0), firstFn(0), lastFn(0), maxFnStep(0) {}
+    LineRun(int b, int e, int first, int last, int step)
+        : begin(b), end(e), firstFn(first), lastFn(last), maxFnStep(step) {}
+
+    int size() const { return end - begin; }
+};
+
+// 按线号编码索引各段点
+// 全部段存放在一个数组中（按下标升序），同一线号的各段用下标串成链，
+// 每条线不再各占一个容器，建立和释放索引只有几次整块分配
+// 遍历一条线：for (int r = index.firstRun(code); r >= 0; r = index.nextRun(r))
+class LineIndex
+{
+public:
+    LineIndex() : m_lines(0) {}
+
+    void clear();
+
+    // 为[first, count)中的点建立索引，codes、fns为全部点的线号编码和点号
+    // 与该线号上一段首尾相接时直接延长
+    void append(const int *codes, const int *fns, int first, int count);
+    // 去掉末尾一个点，code为该点的线号编码，lastFn为去掉后的末尾点号
+    void removeLast(int code, int lastFn);
+
+    // 有点的线数
+    int lineCount() const { return m_lines; }
+    // 编码上限（不含），遍历所有线时用
+    int codeCount() const { return m_first.size(); }
+
+    int firstRun(int code) const { return (code >= 0 && code < m_first.size()) ? m_first.at(code) : -1; }
+    int nextRun(int run) const { return m_next.at(run); }
+    const LineRun &run(int run) const { return m_runs.at(run); }
+
+    // 一条线的各段，按下标升序
+    QVector<LineRun> runs(int code) const;
+
+private:
+    QVector<LineRun> m_runs;    // 全部段
+    QVector<int> m_next;        // 同一线号的下一段，-1为末段
+    QVector<int> m_first;       // 线号编码 -> 首段，-1表示没有点
+    QVector<int> m_last;        // 线号编码 -> 末段
+    int m_lines;
+};
+
+#endif // LINEINDEX_H
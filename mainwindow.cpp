@@ -7,6 +7,8 @@
 #include "previewdialog.h"
 #include <QInputDialog>
 #include "batchtab.h"
+#include "gzipreader.h"
+#include "datscanner.h"
 
 ///删除附加选区功能，优化反选功能
 MainWindow::MainWindow(QWidget *parent)
@@ -17,6 +19,7 @@ MainWindow::MainWindow(QWidget *parent)
 //    , m_statusBar(nullptr)
     , m_progressBar(nullptr)
     , m_statusLabel(nullptr)
+    , m_cancelImportButton(nullptr)
 {
 //    ui->setupUi(this);
     m_projectManager = new ProjectManager(this);
@@ -175,6 +178,14 @@ void MainWindow::setupMenuBar()
     m_clearSelectionAction->setStatusTip("清除所有选择区域");
     m_clearSelectionAction->setEnabled(false);
     viewMenu->addAction(m_clearSelectionAction);
+
+    viewMenu->addSeparator();
+
+    m_compactPointsAction = new QAction("压缩后台架次", this);
+    m_compactPointsAction->setCheckable(true);
+    m_compactPointsAction->setEnabled(false); // 初始禁用，有项目后启用
+    m_compactPointsAction->setStatusTip("不在当前标签页中显示的架次压缩存放点数据，以便同时打开更多架次");
+    viewMenu->addAction(m_compactPointsAction);
 }
 
 void MainWindow::setupToolBar()
@@ -199,8 +210,15 @@ void MainWindow::setupStatusBar()
     m_statusBar->addWidget(m_statusLabel);
 
     m_progressBar = new QProgressBar();
+    m_progressBar->setRange(0, 1000);
+    m_progressBar->setTextVisible(false);
     m_progressBar->hide();
     m_statusBar->addPermanentWidget(m_progressBar);
+
+    m_cancelImportButton = new QPushButton("取消导入");
+    m_cancelImportButton->hide();
+    connect(m_cancelImportButton, &QPushButton::clicked, this, &MainWindow::cancelImports);
+    m_statusBar->addPermanentWidget(m_cancelImportButton);
 }
 
 void MainWindow::createActions()
@@ -226,6 +244,14 @@ void MainWindow::createActions()
             currentTab->resetDataPoints();
         }
     });
+
+    connect(m_compactPointsAction, &QAction::toggled, [this](bool checked) {
+        ProjectModel *project = m_projectManager->currentProject();
+        if (project) {
+            project->setCompactPoints(checked);
+            applyCompactPoints();
+        }
+    });
 }
 
 void MainWindow::onOpenDataFile()
@@ -240,26 +266,46 @@ void MainWindow::onOpenDataFile()
         this,
         "打开DAT文件",
         "",
-        "DAT文件 (*.dat);;所有文件 (*)"
+        "DAT文件 (*.dat *.dat.gz);;所有文件 (*)"
     );
 
     if (filePath.isEmpty())
         return;
 
-    // 检查文件是否符合行数约束
-    bool result = m_projectManager->currentProject()->addDataFile(batchIdx, filePath);
-    if (!result) {
-        // 获取架次信息以显示正确的行数约束
-        const auto& batches = m_projectManager->currentProject()->getBatches();
-        if (batchIdx < batches.size() && batches[batchIdx].size > 0) {
-//            QMessageBox::warning(this, "文件不匹配",
-//                                QString("该文件行数: %2 与架次中其他文件不一致！\n"
-//                                        "要求行数: %1\n").arg(batches[batchIdx].size));
-        } else {
-            QMessageBox::warning(this, "错误", "无法添加测试线文件！");
+    ProjectModel* project = m_projectManager->currentProject();
+    if (!project->canAddDataFile(batchIdx, filePath))
+        return;
+
+    // 同一架次同时只允许一个导入任务，避免两个文件都被当作首个文件解析
+    const Batch& batch = project->getBatches()[batchIdx];
+    if (isBatchImporting(batch.batchName)) {
+        QMessageBox::warning(this, "请稍候", QString("架次 [%1] 正在导入文件").arg(batch.batchName));
+        return;
+    }
+
+    // 首个文件先确认列映射，解析时按映射直接定位字段；后续文件沿用首个文件的映射
+    ColumnMapping mapping = batch.columnMapping;
+    if (batch.size == 0) {
+        PreviewDialog previewDialog(filePath, this);
+        if (previewDialog.exec() != QDialog::Accepted) {
+            return; // 用户取消了配置
         }
+        mapping = previewDialog.getColumnMapping();
     }
 
+    // 首个文件在后台解析坐标，后续文件在后台统计行数并与首个文件逐行比较，界面保持可操作
+    // 两个文件都已扫描过时任务直接取用扫描结果，比较时只回读不对应的块
+    ImportJob* job = new ImportJob(batch.batchName, filePath,
+                                   batch.size == 0 ? ImportJob::ParsePoints : ImportJob::CountRows,
+                                   mapping, this);
+    if (batch.size > 0)
+        job->setReference(batch.filePaths.first());
+    connect(job, &ImportJob::progressChanged, this, &MainWindow::updateImportStatus);
+    connect(job, &ImportJob::finished, this, &MainWindow::onImportFinished);
+    m_importJobs.append(job);
+    job->start();
+    updateImportStatus();
+
 //    PreviewDialog previewDialog(fileName, this);
 //    if (previewDialog.exec() != QDialog::Accepted) {
 //        return; // 用户取消了配置
@@ -303,6 +349,94 @@ void MainWindow::onOpenDataFile()
     //    }
 }
 
+bool MainWindow::isBatchImporting(const QString& batchName) const
+{
+    for (const ImportJob* job : m_importJobs) {
+        if (job->batchName() == batchName)
+            return true;
+    }
+    return false;
+}
+
+void MainWindow::updateImportStatus()
+{
+    if (m_importJobs.isEmpty()) {
+        m_progressBar->hide();
+        m_cancelImportButton->hide();
+        return;
+    }
+
+    qint64 bytesProcessed = 0;
+    qint64 bytesTotal = 0;
+    qint64 rowsProcessed = 0;
+    for (const ImportJob* job : m_importJobs) {
+        bytesProcessed += job->bytesProcessed();
+        bytesTotal += job->bytesTotal();
+        rowsProcessed += job->rowsProcessed();
+    }
+
+    m_progressBar->setValue(bytesTotal > 0 ? int(bytesProcessed * 1000 / bytesTotal) : 0);
+    m_progressBar->show();
+    m_cancelImportButton->show();
+
+    const double mb = 1024.0 * 1024.0;
+    m_statusLabel->setText(QString("正在导入 %1 个文件: %2 / %3 MB, 已处理 %4 行")
+                           .arg(m_importJobs.size())
+                           .arg(bytesProcessed / mb, 0, 'f', 1)
+                           .arg(bytesTotal / mb, 0, 'f', 1)
+                           .arg(rowsProcessed));
+}
+
+void MainWindow::onImportFinished()
+{
+    ImportJob* job = qobject_cast<ImportJob*>(sender());
+    if (!job)
+        return;
+    m_importJobs.removeOne(job);
+    job->deleteLater();
+
+    QString fileName = QFileInfo(job->filePath()).fileName();
+    ProjectModel* project = m_projectManager->currentProject();
+    int batchIdx = project ? project->findBatch(job->batchName()) : -1;
+
+    if (job->isCancelled()) {
+        m_statusLabel->setText(QString("已取消导入: %1").arg(fileName));
+    } else if (!job->succeeded()) {
+        m_statusLabel->setText(QString("导入失败: %1").arg(fileName));
+        QMessageBox::warning(this, "错误", QString("无法读取文件 [%1]！").arg(job->filePath()));
+    } else if (batchIdx < 0) {
+        // 导入期间架次已被删除
+        m_statusLabel->setText(QString("架次 [%1] 已不存在，放弃导入").arg(job->batchName()));
+    } else {
+        bool result = (job->mode() == ImportJob::ParsePoints)
+                ? project->commitParsedDataFile(batchIdx, job->filePath(), job->takePoints(),
+                                                job->columnMapping(), job->parsedEnd())
+                : project->commitCountedDataFile(batchIdx, job->filePath(), job->rowCount(),
+                                                 job->divergingRow());
+        if (result) {
+            m_statusLabel->setText(QString("已导入文件: %1 (%2 行)").arg(fileName).arg(job->rowCount()));
+        } else {
+            m_statusLabel->setText(QString("导入失败: %1").arg(fileName));
+            if (job->mode() == ImportJob::ParsePoints || job->rowCount() <= 0)
+                QMessageBox::warning(this, "错误", "无法添加测试线文件！");
+        }
+    }
+
+    if (!m_importJobs.isEmpty())
+        updateImportStatus();
+    else {
+        m_progressBar->hide();
+        m_cancelImportButton->hide();
+    }
+}
+
+void MainWindow::cancelImports()
+{
+    for (ImportJob* job : m_importJobs) {
+        job->cancel();
+    }
+}
+
 void MainWindow::onAddBatch()
 {
     bool ok;
@@ -389,12 +523,17 @@ void MainWindow::closeCurrentTab()
 {
     int currentIndex = m_tabWidget->currentIndex();
     if (currentIndex >= 0) {
-        BatchTab *tab = qobject_cast<BatchTab*>(m_tabWidget->widget(currentIndex));
-        if (tab) {
-            delete tab->getDataPointData(); // 清理数据
+        QWidget *tab = m_tabWidget->widget(currentIndex);
+        // 标签页要到事件循环中才删除，先停止跟踪，压缩后不会再有点追加进来
+        if (BatchTab *batchTab = qobject_cast<BatchTab*>(tab)) {
+            batchTab->stopFollowing();
         }
-
         m_tabWidget->removeTab(currentIndex);
+        // 点数据归架次所有，只删除标签页本身，架次不再显示后按设置压缩
+        if (tab) {
+            tab->deleteLater();
+        }
+        applyCompactPoints();
 
         if (m_tabWidget->count() == 0) {
             // 没有标签页时禁用相关动作
@@ -411,6 +550,9 @@ void MainWindow::closeCurrentTab()
 
 void MainWindow::onTabChanged(int index)
 {
+    // 切换到的架次先展开，切走的按设置压缩
+    applyCompactPoints();
+
     if (index >= 0) {
         BatchTab *tab = getCurrentTab();
         if (tab) {
@@ -509,46 +651,55 @@ void MainWindow::exportCurrentFile()
 
 bool MainWindow::writeDatFile(const QString &originalPath, const QString &newPath, const Batch &currentBatch)
 {
-    QFile newfile(newPath);
-    if (!newfile.open(QIODevice::WriteOnly | QIODevice::Text)) {
+    // 表头位置和各数据行的偏移取自扫描服务，导入时已扫描过的文件不再逐行识别
+    DatLayout layout;
+    QScopedPointer<QIODevice> originalFile(createDatDevice(originalPath));
+    if (!DatScanner::instance().scan(originalPath, currentBatch.columnMapping, layout, nullptr, true)
+            || !originalFile->open(QIODevice::ReadOnly)) {
+        QMessageBox::warning(nullptr, "错误", "无法打开文件 ");
         return false;
     }
-    QTextStream out(&newfile);
-    out.setCodec("UTF-8");
-//    out << content;
 
-    QFile originalFile(originalPath);
-    if (!originalFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        QMessageBox::warning(nullptr, "错误", "无法打开文件 ");
+    QFile newfile(newPath);
+    if (!newfile.open(QIODevice::WriteOnly | QIODevice::Text)) {
         return false;
     }
-    QTextStream in(&originalFile);
-    in.setCodec("UTF-8");
-    QStringList previewData;
-    QString lastLine;
-
-    // 跳过头部
-    while (!in.atEnd()) {
-        lastLine = in.readLine();
-        out << lastLine;
-        out << "\n";
-        if (lastLine.trimmed().split(' ', QString::SkipEmptyParts)[0] == "LINE")
+    // 统一按\n写出，文本模式下由QFile转换为本平台的换行
+    auto writeLine = [&newfile](QByteArray line) {
+        while (line.endsWith('\n') || line.endsWith('\r'))
+            line.chop(1);
+        line.append('\n');
+        newfile.write(line);
+    };
+
+    // 表头及之前的内容原样写出
+    qint64 pos = 0;
+    const qint64 headerEnd = layout.hasHeader() ? layout.bodyOffset : 0;
+    while (pos < headerEnd) {
+        QByteArray line = originalFile->readLine();
+        if (line.isEmpty())
             break;
+        pos += line.size();
+        writeLine(line);
     }
-    int i = 0;
-    DataPoint point = currentBatch.points[i];
-    while (!in.atEnd()){
-        QString line = in.readLine();
-        if (point.isVisible) {
-            QString newLineId = point.lineId;
+
+    // 第i个数据行对应第i个点，只写出可见的点
+    const PointStore& points = currentBatch.data->points;
+    const int rows = qMin(layout.rowOffsets.size(), points.size());
+    for (int i = 0; i < rows; ++i) {
+        const qint64 offset = layout.rowOffsets[i];
+        if (originalFile->skip(offset - pos) != offset - pos)
+            break;
+        QByteArray line = originalFile->readLine();
+        pos = offset + line.size();
+
+        if (points.isVisible(i)) {
+            const QByteArray newLineId = points.lineId(i).toUtf8();
             line.replace(0, newLineId.size(), newLineId);
-            out << line;
-            out << "\n";
+            writeLine(line);
         }
-        i++;
-        if (i < currentBatch.points.size()) point = currentBatch.points[i];
     }
-    originalFile.close();
+    originalFile->close();
 
     return true;
 }
@@ -617,6 +768,8 @@ void MainWindow::onProjectNewed() {
     m_tabWidget->clear();
     m_openDesignLineAction->setEnabled(true);
     m_addBatchAction->setEnabled(true);
+    m_compactPointsAction->setEnabled(true);
+    m_compactPointsAction->setChecked(m_projectManager->currentProject()->compactPoints());
     m_treeView->setProjectModel(m_projectManager->currentProject());
     connect(m_treeView->selectionModel(), &QItemSelectionModel::selectionChanged,
             this, &MainWindow::onSelectionChanged);
@@ -631,6 +784,8 @@ void MainWindow::onProjectLoaded()
     }
     m_openDesignLineAction->setEnabled(true);
     m_addBatchAction->setEnabled(true);
+    m_compactPointsAction->setEnabled(true);
+    m_compactPointsAction->setChecked(m_projectManager->currentProject()->compactPoints());
     m_treeView->setProjectModel(m_projectManager->currentProject());
     connect(m_treeView->selectionModel(), &QItemSelectionModel::selectionChanged,
             this, &MainWindow::onSelectionChanged);
@@ -638,6 +793,9 @@ void MainWindow::onProjectLoaded()
 
 void MainWindow::onProjectClosed()
 {
+    // 导入结果按架次名提交，项目切换后不能再提交到新项目
+    cancelImports();
+
     /// 关闭所有数据文件
     closeCurrentTab();
     setWindowTitle("测线编辑器");
@@ -667,6 +825,35 @@ bool MainWindow::isTabWidgetOpen(int batchIndex) const {
     return false;
 }
 
+bool MainWindow::isBatchActive(int batchIndex) const
+{
+    for (int i = 0; i < m_tabWidget->count(); ++i) {
+        BatchTab* batchTab = qobject_cast<BatchTab*>(m_tabWidget->widget(i));
+        if (batchTab && batchTab->getBatchIndex() == batchIndex
+                && (i == m_tabWidget->currentIndex() || batchTab->isFollowing())) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void MainWindow::applyCompactPoints()
+{
+    ProjectModel *project = m_projectManager->currentProject();
+    if (!project)
+        return;
+
+    // 只有当前标签页的架次（和正在跟踪的架次）展开为PointStore，
+    // 后台标签页的表格经解码缓存按行读取，同时打开多个架次时内存占用与压缩后相当
+    QList<Batch>& batches = project->getBatches();
+    for (int i = 0; i < batches.size(); ++i) {
+        if (!project->compactPoints() || isBatchActive(i))
+            batches[i].data->expand();
+        else
+            batches[i].data->compact();
+    }
+}
+
 void MainWindow::openTabWidget(int batchIndex) {
     // 检查标签页是否已打开
     if (isTabWidgetOpen(batchIndex)) {
@@ -23,6 +23,7 @@
 #include "plotwidget.h"
 #include "projectmanager.h"
 #include "projecttreeview.h"
+#include "importjob.h"
 
 class BatchTab;
 
@@ -62,6 +63,11 @@ private slots:
     void onBatchDoubleClicked(int batchIndex);
     void onSelectionChanged();
 
+    // 后台导入
+    void onImportFinished();
+    void updateImportStatus();
+    void cancelImports();
+
     /// 项目文件操作，由projectmanager统一管理
 //    void onNewProject();
 //    void onOpenProject();
@@ -78,6 +84,9 @@ private:
     QStatusBar *m_statusBar;
     QProgressBar *m_progressBar;
     QLabel *m_statusLabel;
+    QPushButton *m_cancelImportButton;
+
+    QList<ImportJob*> m_importJobs;     // 正在后台运行的导入任务
 
     // Actions
     QAction *m_openDataAction;
@@ -92,6 +101,7 @@ private:
     QAction *m_zoomToFitAction;
     QAction *m_clearSelectionAction;
     QAction *m_resetAction;
+    QAction *m_compactPointsAction;
 
     void createActions();
     void setupUI();
@@ -100,6 +110,11 @@ private:
     void setupStatusBar();
 
     bool isTabWidgetOpen(int batchIndex) const;
+    // 架次在当前标签页中显示，或其标签页正在跟踪文件增长
+    bool isBatchActive(int batchIndex) const;
+    // 按项目设置压缩不在使用中的架次（包括在后台的标签页），或全部展开
+    void applyCompactPoints();
+    bool isBatchImporting(const QString& batchName) const;
     void openTabWidget(int batchIndex);
 
     // 加载DAT文件
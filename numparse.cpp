@@ -0,0 +1,193 @@
+#include "numparse.h"
+#include <QLocale>
+#include <QString>
+#include <climits>
+
+namespace {
+
+// 10^0 ~ 10^22 都能用double精确表示
+const double ExactPowersOf10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+const int MaxExactPower = 22;
+
+// 尾数不超过2^53时可以精确转为double
+const quint64 MaxExactMantissa = quint64(1) << 53;
+
+// 尾数最多累积19位十进制数字，不会溢出quint64
+const int MaxMantissaDigits = 19;
+
+inline unsigned charCode(char c) { return uchar(c); }
+inline unsigned charCode(QChar c) { return c.unicode(); }
+
+const QLocale &cLocale()
+{
+    static const QLocale locale = [] {
+        QLocale c = QLocale::c();
+        c.setNumberOptions(QLocale::RejectGroupSeparator);
+        return c;
+    }();
+    return locale;
+}
+
+template <typename Char>
+int parseInt(const Char *p, const Char *end, bool *ok)
+{
+    if (ok)
+        *ok = false;
+
+    bool negative = false;
+    if (p < end && (charCode(*p) == '+' || charCode(*p) == '-')) {
+        negative = (charCode(*p) == '-');
+        ++p;
+    }
+    if (p == end)
+        return 0;
+
+    qint64 value = 0;
+    for (; p < end; ++p) {
+        const unsigned digit = charCode(*p) - '0';
+        if (digit > 9)
+            return 0;
+        value = value * 10 + digit;
+        if (value > qint64(INT_MAX) + 1)
+            return 0;
+    }
+    if (negative)
+        value = -value;
+    if (value > INT_MAX)
+        return 0;
+
+    if (ok)
+        *ok = true;
+    return int(value);
+}
+
+// Clinger快速路径：尾数和10的幂都能精确表示时，一次乘除即为正确舍入的结果
+// 形如[+-]digits[.digits][(e|E)[+-]digits]且满足精度条件时返回true，否则交给完整转换
+template <typename Char>
+bool parseDoubleFast(const Char *p, const Char *end, double &result)
+{
+    bool negative = false;
+    if (p < end && (charCode(*p) == '+' || charCode(*p) == '-')) {
+        negative = (charCode(*p) == '-');
+        ++p;
+    }
+
+    quint64 mantissa = 0;
+    int digits = 0;         // 有效数字位数（不含前导零）
+    int exponent = 0;
+    bool anyDigit = false;
+
+    for (; p < end; ++p) {
+        const unsigned digit = charCode(*p) - '0';
+        if (digit > 9)
+            break;
+        anyDigit = true;
+        if (mantissa != 0 || digit != 0) {
+            if (digits == MaxMantissaDigits)
+                return false;
+            mantissa = mantissa * 10 + digit;
+            ++digits;
+        }
+    }
+
+    if (p < end && charCode(*p) == '.') {
+        for (++p; p < end; ++p) {
+            const unsigned digit = charCode(*p) - '0';
+            if (digit > 9)
+                break;
+            anyDigit = true;
+            if (mantissa != 0 || digit != 0) {
+                if (digits == MaxMantissaDigits)
+                    return false;
+                mantissa = mantissa * 10 + digit;
+                ++digits;
+            }
+            --exponent;
+        }
+    }
+    if (!anyDigit)
+        return false;
+
+    if (p < end && (charCode(*p) == 'e' || charCode(*p) == 'E')) {
+        ++p;
+        bool exponentNegative = false;
+        if (p < end && (charCode(*p) == '+' || charCode(*p) == '-')) {
+            exponentNegative = (charCode(*p) == '-');
+            ++p;
+        }
+        int value = 0;
+        bool anyExponentDigit = false;
+        for (; p < end; ++p) {
+            const unsigned digit = charCode(*p) - '0';
+            if (digit > 9)
+                break;
+            anyExponentDigit = true;
+            if (value < 100000)
+                value = value * 10 + int(digit);
+        }
+        if (!anyExponentDigit)
+            return false;
+        exponent += exponentNegative ? -value : value;
+    }
+
+    if (p != end || mantissa > MaxExactMantissa)
+        return false;
+
+    double value = double(mantissa);
+    if (mantissa != 0) {
+        if (exponent < -MaxExactPower || exponent > MaxExactPower)
+            return false;
+        if (exponent < 0)
+            value /= ExactPowersOf10[-exponent];
+        else
+            value *= ExactPowersOf10[exponent];
+    }
+    result = negative ? -value : value;
+    return true;
+}
+
+}
+
+int NumParse::toInt(const char *begin, const char *end, bool *ok)
+{
+    return parseInt(begin, end, ok);
+}
+
+int NumParse::toInt(QStringView text, bool *ok)
+{
+    return parseInt(text.data(), text.data() + text.size(), ok);
+}
+
+double NumParse::toDouble(const char *begin, const char *end, bool *ok)
+{
+    double value;
+    if (parseDoubleFast(begin, end, value)) {
+        if (ok)
+            *ok = true;
+        return value;
+    }
+
+    // 完整转换：字段较短时在栈上转成UTF-16，避免堆分配
+    const int length = int(end - begin);
+    QChar buffer[64];
+    if (length > int(sizeof(buffer) / sizeof(buffer[0])))
+        return cLocale().toDouble(QString::fromLatin1(begin, length), ok);
+
+    for (int i = 0; i < length; ++i)
+        buffer[i] = QLatin1Char(begin[i]);
+    return cLocale().toDouble(QStringView(buffer, length), ok);
+}
+
+double NumParse::toDouble(QStringView text, bool *ok)
+{
+    double value;
+    if (parseDoubleFast(text.data(), text.data() + text.size(), value)) {
+        if (ok)
+            *ok = true;
+        return value;
+    }
+    return cLocale().toDouble(text, ok);
+}
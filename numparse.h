@@ -0,0 +1,21 @@
+#ifndef NUMPARSE_H
+#define NUMPARSE_H
+
+#include <QStringView>
+
+// 数值解析内核：直接在字节或UTF-16字符区间上转换，不构造QString
+// 结果与QString::toInt()/toDouble()完全一致（C locale，拒绝千分位），
+// 区间内不应含首尾空白，非法或溢出时返回0并将ok置为false
+namespace NumParse {
+
+int toInt(const char *begin, const char *end, bool *ok = nullptr);
+int toInt(QStringView text, bool *ok = nullptr);
+
+// 常见的十进制小数（有效数字不超过15位、指数不超过22）走精确的快速路径，
+// 其余情况（超长尾数、大指数、inf/nan等）交给QLocale转换，保证逐位一致
+double toDouble(const char *begin, const char *end, bool *ok = nullptr);
+double toDouble(QStringView text, bool *ok = nullptr);
+
+}
+
+#endif // NUMPARSE_H
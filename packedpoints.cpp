@@ -0,0 +1,327 @@
+#include "packedpoints.h"
+#include "datastructures.h"
+#include <QtAlgorithms>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+enum Mode { Delta = 0, Xor = 1 };
+
+// 坐标和高度最多按4位小数换算为整数，不能精确表示时按二进制位异或
+const int MaxDecimals = 4;
+const double Powers[MaxDecimals + 1] = { 1, 10, 100, 1000, 10000 };
+// 换算后的整数须能由double精确表示
+const double MaxScaled = 9007199254740992.0;   // 2^53
+
+quint64 zigzag(qint64 value)
+{
+    return (quint64(value) << 1) ^ quint64(value >> 63);
+}
+
+qint64 unzigzag(quint64 value)
+{
+    return qint64(value >> 1) ^ -qint64(value & 1);
+}
+
+quint64 doubleBits(double value)
+{
+    quint64 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+double bitsDouble(quint64 bits)
+{
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+quint64 readBits(const quint64 *words, int index, int width)
+{
+    const qint64 bit = qint64(index) * width;
+    const int w = int(bit >> 6);
+    const int shift = int(bit & 63);
+    quint64 value = words[w] >> shift;
+    if (shift + width > 64)
+        value |= words[w + 1] << (64 - shift);
+    return width == 64 ? value : value & ((quint64(1) << width) - 1);
+}
+
+// value按decimals位小数换算为整数后能否原样还原
+bool fitsDecimals(double value, int decimals, qint64 *scaled)
+{
+    const double s = value * Powers[decimals];
+    if (!(qAbs(s) < MaxScaled))
+        return false;
+    const qint64 q = qRound64(s);
+    if (double(q) / Powers[decimals] != value)
+        return false;
+    *scaled = q;
+    return true;
+}
+
+}
+
+PackedPoints::PackedPoints()
+    : m_size(0)
+    , m_useClock(0)
+{
+}
+
+void PackedPoints::clear()
+{
+    m_blocks.clear();
+    m_words.clear();
+    m_lineRuns.clear();
+    m_visible = PointBitset();
+    m_normalAlt = PointBitset();
+    m_lineNames.clear();
+    m_size = 0;
+    m_cache.clear();
+    m_useClock = 0;
+}
+
+void PackedPoints::pack(const PointStore &points)
+{
+    clear();
+    m_size = points.size();
+
+    m_lineNames.reserve(points.lineCount());
+    for (int code = 0; code < points.lineCount(); ++code)
+        m_lineNames.append(points.lineName(code));
+
+    m_visible = points.visibility();
+    m_normalAlt.resize(m_size, true);
+    for (int i = 0; i < m_size; ++i) {
+        if (!points.isNormalAlt(i))
+            m_normalAlt.set(i, false);
+    }
+
+    const int *fns = points.fnData();
+    const int *codes = points.lineCodeData();
+    QVector<qint64> ints;
+    m_blocks.reserve((m_size + BlockSize - 1) / BlockSize);
+    for (int first = 0; first < m_size; first += BlockSize) {
+        Block block;
+        block.count = qMin(int(BlockSize), m_size - first);
+        block.runOffset = m_lineRuns.size();
+
+        for (int i = first; i < first + block.count; ++i) {
+            if (block.runCount == 0 || codes[i] != m_lineRuns.at(m_lineRuns.size() - 2)) {
+                m_lineRuns.append(codes[i]);
+                m_lineRuns.append(0);
+                ++block.runCount;
+            }
+            ++m_lineRuns.last();
+        }
+
+        ints.resize(block.count);
+        for (int i = 0; i < block.count; ++i)
+            ints[i] = fns[first + i];
+        packInts(ints.constData(), block.count, block.fn);
+        packDoubles(points.xData() + first, block.count, block.x);
+        packDoubles(points.yData() + first, block.count, block.y);
+        packDoubles(points.altData() + first, block.count, block.alt);
+
+        m_blocks.append(block);
+    }
+
+    // 去掉增长时预留的空间
+    m_words.squeeze();
+    m_lineRuns.squeeze();
+}
+
+PointStore PackedPoints::unpack() const
+{
+    PointStore points;
+    points.reserve(m_size);
+    for (const QString &name : m_lineNames)
+        points.internLine(name);
+
+    // 同一线号的一段整块追加
+    Decoded block;
+    for (int b = 0; b < m_blocks.size(); ++b) {
+        decodeBlock(b, block);
+        const int *runs = m_lineRuns.constData() + m_blocks.at(b).runOffset;
+        int offset = 0;
+        for (int r = 0; r < m_blocks.at(b).runCount; ++r) {
+            const int count = runs[2 * r + 1];
+            points.append(runs[2 * r], count, block.fn.constData() + offset, block.x.constData() + offset,
+                          block.y.constData() + offset, block.alt.constData() + offset);
+            offset += count;
+        }
+    }
+
+    points.setVisibility(m_visible);
+    for (int i = 0; i < m_size; ++i) {
+        if (!m_normalAlt.test(i))
+            points.setNormalAlt(i, false);
+    }
+    return points;
+}
+
+qint64 PackedPoints::byteSize() const
+{
+    return qint64(m_visible.wordCount() + m_normalAlt.wordCount() + m_words.size()) * sizeof(quint64)
+            + qint64(m_lineRuns.size()) * sizeof(int) + qint64(m_blocks.size()) * sizeof(Block);
+}
+
+DataPoint PackedPoints::at(int i) const
+{
+    const Decoded &block = decoded(i / BlockSize);
+    const int j = i % BlockSize;
+    DataPoint point(m_lineNames.at(block.lineCode.at(j)), block.fn.at(j),
+                    block.x.at(j), block.y.at(j), block.alt.at(j));
+    point.isVisible = m_visible.test(i);
+    point.isNormalAlt = m_normalAlt.test(i);
+    return point;
+}
+
+void PackedPoints::packCodes(const QVector<quint64> &codes, Column &column)
+{
+    quint64 all = 0;
+    for (quint64 code : codes)
+        all |= code;
+    column.width = all ? quint8(64 - qCountLeadingZeroBits(all)) : 0;
+    column.offset = m_words.size();
+    column.wordCount = 0;
+    if (column.width == 0)
+        return;
+
+    const int width = column.width;
+    column.wordCount = int((qint64(codes.size()) * width + 63) / 64);
+    m_words.insert(m_words.size(), column.wordCount, 0);
+    quint64 *words = m_words.data() + column.offset;
+    for (int i = 0; i < codes.size(); ++i) {
+        const qint64 bit = qint64(i) * width;
+        const int w = int(bit >> 6);
+        const int shift = int(bit & 63);
+        words[w] |= codes.at(i) << shift;
+        if (shift + width > 64)
+            words[w + 1] |= codes.at(i) >> (64 - shift);
+    }
+}
+
+void PackedPoints::packInts(const qint64 *values, int count, Column &column)
+{
+    column.mode = Delta;
+    column.first = count > 0 ? quint64(values[0]) : 0;
+    QVector<quint64> codes(qMax(count - 1, 0));
+    for (int i = 1; i < count; ++i)
+        codes[i - 1] = zigzag(values[i] - values[i - 1]);
+    packCodes(codes, column);
+}
+
+void PackedPoints::packDoubles(const double *values, int count, Column &column)
+{
+    // 找出全块都能精确换算的最少小数位数
+    QVector<qint64> scaled(count);
+    int decimals = 0;
+    for (int i = 0; i < count && decimals <= MaxDecimals; ++i) {
+        while (decimals <= MaxDecimals && !fitsDecimals(values[i], decimals, &scaled[i]))
+            ++decimals;
+    }
+    if (decimals <= MaxDecimals) {
+        for (int i = 0; i < count; ++i)
+            fitsDecimals(values[i], decimals, &scaled[i]);
+        packInts(scaled.constData(), count, column);
+        column.decimals = qint8(decimals);
+        return;
+    }
+
+    // 相邻的值符号、阶码和尾数高位多半相同，异或后高位为0
+    column.mode = Xor;
+    column.decimals = 0;
+    column.first = count > 0 ? doubleBits(values[0]) : 0;
+    QVector<quint64> codes(qMax(count - 1, 0));
+    for (int i = 1; i < count; ++i)
+        codes[i - 1] = doubleBits(values[i]) ^ doubleBits(values[i - 1]);
+    packCodes(codes, column);
+}
+
+void PackedPoints::unpackInts(const Column &column, int count, qint64 *values) const
+{
+    if (count <= 0)
+        return;
+    values[0] = qint64(column.first);
+    const quint64 *words = m_words.constData() + column.offset;
+    for (int i = 1; i < count; ++i) {
+        const quint64 code = column.width ? readBits(words, i - 1, column.width) : 0;
+        values[i] = values[i - 1] + unzigzag(code);
+    }
+}
+
+void PackedPoints::unpackDoubles(const Column &column, int count, double *values) const
+{
+    if (count <= 0)
+        return;
+    if (column.mode == Delta) {
+        QVector<qint64> scaled(count);
+        unpackInts(column, count, scaled.data());
+        const double power = Powers[column.decimals];
+        for (int i = 0; i < count; ++i)
+            values[i] = double(scaled.at(i)) / power;
+        return;
+    }
+
+    quint64 bits = column.first;
+    values[0] = bitsDouble(bits);
+    const quint64 *words = m_words.constData() + column.offset;
+    for (int i = 1; i < count; ++i) {
+        if (column.width)
+            bits ^= readBits(words, i - 1, column.width);
+        values[i] = bitsDouble(bits);
+    }
+}
+
+void PackedPoints::decodeBlock(int b, Decoded &out) const
+{
+    const Block &block = m_blocks.at(b);
+    out.block = b;
+
+    QVector<qint64> fns(block.count);
+    unpackInts(block.fn, block.count, fns.data());
+    out.fn.resize(block.count);
+    for (int i = 0; i < block.count; ++i)
+        out.fn[i] = int(fns.at(i));
+
+    out.lineCode.resize(block.count);
+    const int *runs = m_lineRuns.constData() + block.runOffset;
+    int *codes = out.lineCode.data();
+    for (int r = 0; r < block.runCount; ++r) {
+        std::fill(codes, codes + runs[2 * r + 1], runs[2 * r]);
+        codes += runs[2 * r + 1];
+    }
+
+    out.x.resize(block.count);
+    out.y.resize(block.count);
+    out.alt.resize(block.count);
+    unpackDoubles(block.x, block.count, out.x.data());
+    unpackDoubles(block.y, block.count, out.y.data());
+    unpackDoubles(block.alt, block.count, out.alt.data());
+}
+
+const PackedPoints::Decoded &PackedPoints::decoded(int b) const
+{
+    // 命中时只更新使用时间；未命中时覆盖最久未用的一项，各列沿用原有的空间
+    Decoded *slot = nullptr;
+    for (Decoded &entry : m_cache) {
+        if (entry.block == b) {
+            entry.lastUse = ++m_useClock;
+            return entry;
+        }
+        if (!slot || entry.lastUse < slot->lastUse)
+            slot = &entry;
+    }
+
+    if (m_cache.size() < CacheBlocks) {
+        m_cache.append(Decoded());
+        slot = &m_cache.last();
+    }
+    decodeBlock(b, *slot);
+    slot->lastUse = ++m_useClock;
+    return *slot;
+}
@@ -0,0 +1,105 @@
+#ifndef PACKEDPOINTS_H
+#define PACKEDPOINTS_H
+
+#include <QString>
+#include <QVector>
+#include <QtGlobal>
+#include "pointbitset.h"
+
+class PointStore;
+struct DataPoint;
+
+// 压缩存放的点数据，用于不在当前标签页中显示的架次常驻内存
+// 每BlockSize个点一块，各列分别编码：
+//   点号：与前一点的差值，按块内最大差值的位数紧密排列
+//   坐标：能按不超过4位小数精确表示时，换算为整数后同样按差值排列；
+//         否则与前一点的二进制位异或后排列，均为无损
+//   高度：同坐标
+//   线号：同一线号的点连续出现，按（编码, 点数）成段记录
+// 可见性和高度是否正常各为每点一位的位图，不压缩
+// 各块的编码数据依次存放在同一个数组中，压缩和释放一个架次只有几次整块分配
+// 按下标读取时整块解码，最近用到的几块留在缓存中，顺序遍历时每块只解码一次；
+// 缓存的各项重复使用，换入新块时不重新分配
+class PackedPoints
+{
+public:
+    enum { BlockSize = 4096, CacheBlocks = 8 };
+
+    PackedPoints();
+
+    int size() const { return m_size; }
+    bool isEmpty() const { return m_size == 0; }
+    void clear();
+
+    void pack(const PointStore &points);
+    PointStore unpack() const;
+
+    // 压缩后占用的字节数（不含解码缓存），用于状态显示
+    qint64 byteSize() const;
+
+    // 按行取出单个点，经解码缓存
+    DataPoint at(int i) const;
+    bool isVisible(int i) const { return m_visible.test(i); }
+    const PointBitset &visibility() const { return m_visible; }
+
+private:
+    // 一列整数编码：首个值原样保存，其后各值与前一值的差（或异或）按width位排列，
+    // 存放在m_words的[offset, offset + wordCount)中
+    struct Column {
+        quint8 mode;        // Delta或Xor
+        qint8 decimals;     // Delta时换算为整数所乘10的幂次
+        quint8 width;       // 每个值占的位数，0表示各值相同
+        quint64 first;
+        int offset;
+        int wordCount;
+
+        Column() : mode(0), decimals(0), width(0), first(0), offset(0), wordCount(0) {}
+    };
+
+    struct Block {
+        int count;
+        int runOffset;      // 线号段在m_lineRuns中的位置，依次为线号编码、点数
+        int runCount;       // 段数
+        Column fn;
+        Column x;
+        Column y;
+        Column alt;
+
+        Block() : count(0), runOffset(0), runCount(0) {}
+    };
+
+    // 解码后的一块
+    struct Decoded {
+        int block;
+        quint64 lastUse;
+        QVector<int> fn;
+        QVector<int> lineCode;
+        QVector<double> x;
+        QVector<double> y;
+        QVector<double> alt;
+
+        Decoded() : block(-1), lastUse(0) {}
+    };
+
+    void packCodes(const QVector<quint64> &codes, Column &column);
+    void packInts(const qint64 *values, int count, Column &column);
+    void packDoubles(const double *values, int count, Column &column);
+    void unpackInts(const Column &column, int count, qint64 *values) const;
+    void unpackDoubles(const Column &column, int count, double *values) const;
+
+    void decodeBlock(int b, Decoded &out) const;
+    const Decoded &decoded(int b) const;
+
+    QVector<Block> m_blocks;
+    QVector<quint64> m_words;       // 各块各列的编码
+    QVector<int> m_lineRuns;        // 各块的线号段
+    PointBitset m_visible;
+    PointBitset m_normalAlt;
+    QVector<QString> m_lineNames;
+    int m_size;
+
+    mutable QVector<Decoded> m_cache;
+    mutable quint64 m_useClock;
+};
+
+#endif // PACKEDPOINTS_H
@@ -6,12 +6,15 @@
 #include <QRubberBand>
 #include <qmath.h>
 #include <QInputDialog>
+#include <QElapsedTimer>
+#include <QThread>
 
 PlotWidget::PlotWidget(QWidget *parent)
     : QWidget(parent)
     , m_dataPointData(nullptr)
     , m_offset(0, 0)
     , m_scale(1.0)
+    , m_zoomLevel(0)
     , m_rubberBand(nullptr)
 //    , m_selectionMode(Normal)
     , m_normalAltColor(Qt::blue)
@@ -25,12 +28,25 @@ PlotWidget::PlotWidget(QWidget *parent)
     setFocusPolicy(Qt::StrongFocus);
     setMouseTracking(true);
     m_rubberBand = new QRubberBand(QRubberBand::Rectangle, this);
+    m_tiles.setMaxCost(tileCacheKB);
+    m_coarseTiles.setMaxCost(coarseCacheKB);
+    // 留一个核给界面线程
+    m_renderPool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() - 1));
     connect(this, &PlotWidget::pointDoubleClicked, this, &PlotWidget::highlightLine);
 }
 
+PlotWidget::~PlotWidget()
+{
+    // 工作线程完成回调中引用本对象，须等它们结束
+    discardTiles();
+    m_renderPool.waitForDone();
+}
+
 void PlotWidget::setBatchData(DataPointData *data)
 {
     m_dataPointData = data;
+    m_pyramid.clear();
+    discardTiles();
     if (data) {
         updateDataRect();
         zoomToFit();
@@ -76,14 +92,22 @@ void PlotWidget::zoomToFit()
     double scaleX = widgetSize.width() / m_dataRect.width();
     double scaleY = widgetSize.height() / m_dataRect.height();
 
-    m_scale = qMin(scaleX, scaleY) * 0.9; // 留一些边距
+    // 取不超过适合比例的缩放级别，留一些边距
+    const double fitScale = qMin(scaleX, scaleY) * 0.9;
+    setZoomLevel(qIsFinite(fitScale) && fitScale > 0
+                 ? int(std::floor(std::log(fitScale) / std::log(zoomStep))) : 0);
 
     // 居中
     QPointF center = m_dataRect.center();
     m_offset = QPointF(widgetSize.width() / 2.0, widgetSize.height() / 2.0) -
                QPointF(center.x() * m_scale, center.y() * m_scale);
-    invalidatePoints();
-//    update();
+    update();
+}
+
+void PlotWidget::setZoomLevel(int level)
+{
+    m_zoomLevel = qBound(int(minZoomLevel), level, int(maxZoomLevel));
+    m_scale = std::pow(zoomStep, m_zoomLevel);
 }
 
 /// 只要有一点点改变就会调用paintEvent，进而调用drawPoints，paintEvent太臃肿了所以很卡
@@ -98,7 +122,8 @@ void PlotWidget::paintEvent(QPaintEvent *event)
     // 绘制背景
     painter.fillRect(rect(), Qt::white);
 
-    if (!m_dataPointData)
+    // 点数据压缩存放时标签页在后台，不必绘制
+    if (!m_dataPointData || m_dataPointData->isCompact())
         return;
 
     // 绘制网格
@@ -115,16 +140,17 @@ void PlotWidget::paintEvent(QPaintEvent *event)
     // 绘制选择区域
 //    drawSelectionRegions(painter);
 
-    // 更新数据点缓存（只在需要时更新）
-     if (m_pointsDirty || m_pointsCache.size() != size()) {
-         updatePointsCache();
+    // 数据改变或要求重画时丢弃全部图块
+     if (m_pointsDirty || m_dataPointData->revision() != m_tileRevision) {
+         discardTiles();
+         m_tileRevision = m_dataPointData->revision();
          m_pointsDirty = false;
      }
 
      drawHighlightPoints(painter);
 
      // 合成所有图层
-     painter.drawPixmap(0, 0, m_pointsCache);
+     drawTiles(painter);
 
     // 绘制多边形选区
     if (!m_vertices.isEmpty()) {
@@ -148,14 +174,206 @@ void PlotWidget::paintEvent(QPaintEvent *event)
     }
 }
 
-void PlotWidget::updatePointsCache()
+void PlotWidget::appendPoints(int first)
 {
-    m_pointsCache = QPixmap(size());
-    m_pointsCache.fill(Qt::transparent);
+    if (!m_dataPointData)
+        return;
 
-    QPainter painter(&m_pointsCache);
-    painter.setRenderHint(QPainter::Antialiasing);
-    drawPoints(painter);
+    // 当前缩放级别的图块只把新点补画上去，改记为新的数据版本，不重绘已有的点；
+    // 其他级别的图块丢弃
+    if (!m_pointsDirty) {
+        const quint64 revision = m_dataPointData->revision();
+        const PointScene scene = pointScene();
+        const PointRenderer renderer(scene);
+        m_coarseTiles.clear();
+        const QList<TileKey> keys = m_tiles.keys();
+        for (const TileKey &key : keys) {
+            QImage *image = m_tiles.take(key);
+            if (key.zoom != m_zoomLevel || key.revision != m_tileRevision) {
+                delete image;
+                continue;
+            }
+
+            QPainter painter(image);
+            painter.setRenderHint(QPainter::Antialiasing);
+            painter.translate(-tileRect(key.tx, key.ty).topLeft());
+            renderer.drawRange(painter, first, scene.points.size());
+            painter.end();
+
+            TileKey current = key;
+            current.revision = revision;
+            m_tiles.insert(current, image, tileSize * tileSize * 4 / 1024);
+        }
+        m_tileRevision = revision;
+    }
+    update();
+}
+
+void PlotWidget::drawTiles(QPainter &painter)
+{
+    // 没有缓存的图块交给后台绘制，完成前先显示粗略图块（抽稀更多的一级）；
+    // 粗略图块也没有时在本帧的时间预算内当场绘制，超出预算的先空着，后台完成后再补上
+    QElapsedTimer frame;
+    frame.start();
+    const PointScene scene = pointScene();
+    const QRect range = tileRange(rect());
+    for (int ty = range.top(); ty <= range.bottom(); ++ty) {
+        for (int tx = range.left(); tx <= range.right(); ++tx) {
+            const TileKey key = tileKey(tx, ty);
+            QImage *image = m_tiles.object(key);
+            if (!image) {
+                image = m_coarseTiles.object(key);
+                if (!image && frame.elapsed() < frameBudgetMs)
+                    image = renderCoarseTile(key, scene);
+                if (!m_tiles.contains(key))
+                    requestTile(key, scene);
+            }
+            if (image)
+                painter.drawImage(tileRect(tx, ty).topLeft(), *image);
+        }
+    }
+
+    // 视口四周一圈的图块也在后台画好，平移时多半已在缓存中
+    const QRect ring = range.adjusted(-1, -1, 1, 1);
+    for (int ty = ring.top(); ty <= ring.bottom(); ++ty) {
+        for (int tx = ring.left(); tx <= ring.right(); ++tx) {
+            const TileKey key = tileKey(tx, ty);
+            if (!range.contains(tx, ty) && !m_tiles.contains(key))
+                requestTile(key, scene);
+        }
+    }
+    cancelStaleTiles(ring);
+}
+
+QRect PlotWidget::tileRange(const QRect &screenRect) const
+{
+    // 图块按局部坐标乘以m_scale后的像素划分，y向上为正
+    const LocalTransform toScreen = localTransform();
+    const int left = int(std::floor((screenRect.left() - toScreen.originX) / tileSize));
+    const int right = int(std::floor((screenRect.right() - toScreen.originX) / tileSize));
+    const int top = int(std::floor((toScreen.originY - screenRect.bottom()) / tileSize));
+    const int bottom = int(std::floor((toScreen.originY - screenRect.top()) / tileSize));
+    return QRect(QPoint(left, top), QPoint(right, bottom));
+}
+
+QRectF PlotWidget::tileRect(int tx, int ty) const
+{
+    const LocalTransform toScreen = localTransform();
+    return QRectF(toScreen.originX + double(tx) * tileSize,
+                  toScreen.originY - double(ty + 1) * tileSize, tileSize, tileSize);
+}
+
+PointScene PlotWidget::pointScene() const
+{
+    PointScene scene;
+    scene.points = m_dataPointData->points;
+    scene.localX = m_dataPointData->localXColumn();
+    scene.localY = m_dataPointData->localYColumn();
+    const LocalTransform toScreen = localTransform();
+    scene.scale = toScreen.scale;
+    scene.originX = toScreen.originX;
+    scene.originY = toScreen.originY;
+    scene.normalAltColor = m_normalAltColor;
+    scene.abnormalAltColor = m_abnormalAltColor;
+    scene.lineSegmentColor = m_lineSegmentColor;
+    scene.pointRadius = m_pointRadius;
+    return scene;
+}
+
+PointSelection PlotWidget::selectPoints(const QRectF &screenRect, int level)
+{
+    // 一个像素超过2米时，每个像素大小的方格每条线只画一个点（高度异常点全画），
+    // 画的点数只与图面大小有关，不随架次的点数增长
+    PointSelection selection;
+    if (level >= 0) {
+        selection.thinned = true;
+        selection.entries = m_pyramid.level(*m_dataPointData, level);
+        return selection;
+    }
+
+    // 只取screenRect内的点：按网格取出该范围（向外放宽一个点的大小）内的各段点下标；
+    // 两端都在范围外的线段不画，相邻点相距很近，只在放得极大时才可能出现
+    const QRectF drawRect = screenRect.adjusted(-m_pointRadius - 1, -m_pointRadius - 1,
+                                                m_pointRadius + 1, m_pointRadius + 1);
+    const QPointF topLeft = screenToWorld(drawRect.topLeft());
+    const QPointF bottomRight = screenToWorld(drawRect.bottomRight());
+    const QPointF origin = m_dataPointData->localOrigin();
+    const QRectF viewRect = QRectF(topLeft, bottomRight).normalized().translated(-origin);
+    m_dataPointData->grid.query(viewRect, selection.ranges);
+    return selection;
+}
+
+void PlotWidget::requestTile(const TileKey &key, const PointScene &scene)
+{
+    if (m_pendingTiles.contains(key))
+        return;
+
+    // 抽稀的各级和网格查询只在界面线程中使用，选好点后连同快照交给工作线程
+    const QRectF rect = tileRect(key.tx, key.ty);
+    const PointSelection selection = selectPoints(rect, PointPyramid::levelFor(1.0 / m_scale));
+    QSharedPointer<QAtomicInt> cancelled(new QAtomicInt(0));
+    m_pendingTiles.insert(key, cancelled);
+    m_renderPool.start(new TileRenderTask(scene, selection, rect, cancelled,
+                                          [this, key](const QImage &image) {
+        QMetaObject::invokeMethod(this, [this, key, image]() {
+            onTileRendered(key, image);
+        }, Qt::QueuedConnection);
+    }));
+}
+
+QImage *PlotWidget::renderCoarseTile(const TileKey &key, const PointScene &scene)
+{
+    const QRectF rect = tileRect(key.tx, key.ty);
+    const int coarseLevel = PointPyramid::levelFor(coarseCellSize / m_scale);
+    const PointRenderer renderer(scene);
+    if (coarseLevel < 0) {
+        // 放得很大，图块中只有少数点，直接画完整的，不再等后台
+        QImage *image = new QImage(renderer.renderTile(selectPoints(rect, -1), rect));
+        m_tiles.insert(key, image, tileSize * tileSize * 4 / 1024);
+        return m_tiles.object(key);
+    }
+
+    QImage *image = new QImage(renderer.renderTile(selectPoints(rect, coarseLevel), rect));
+    m_coarseTiles.insert(key, image, tileSize * tileSize * 4 / 1024);
+    return image;
+}
+
+void PlotWidget::onTileRendered(const TileKey &key, const QImage &image)
+{
+    // 期间已被取消（视图或数据已变）的结果丢弃
+    if (!m_pendingTiles.contains(key))
+        return;
+    m_pendingTiles.remove(key);
+    if (!m_dataPointData || key.revision != m_dataPointData->revision())
+        return;
+
+    m_tiles.insert(key, new QImage(image), tileSize * tileSize * 4 / 1024);
+    m_coarseTiles.remove(key);
+    update();
+}
+
+void PlotWidget::cancelStaleTiles(const QRect &keep)
+{
+    for (auto it = m_pendingTiles.begin(); it != m_pendingTiles.end(); ) {
+        const TileKey &key = it.key();
+        const bool current = key.zoom == m_zoomLevel && key.revision == m_tileRevision
+                && keep.contains(key.tx, key.ty) && !m_tiles.contains(key);
+        if (current) {
+            ++it;
+        } else {
+            it.value()->storeRelease(1);
+            it = m_pendingTiles.erase(it);
+        }
+    }
+}
+
+void PlotWidget::discardTiles()
+{
+    for (const QSharedPointer<QAtomicInt> &cancelled : m_pendingTiles)
+        cancelled->storeRelease(1);
+    m_pendingTiles.clear();
+    m_tiles.clear();
+    m_coarseTiles.clear();
 }
 
 void PlotWidget::mousePressEvent(QMouseEvent *event)
@@ -225,8 +443,7 @@ void PlotWidget::mouseMoveEvent(QMouseEvent *event)
                 m_offset.setX(m_offset.x() + delta.x());
                 m_offset.setY(m_offset.y() - delta.y());
                 pressPos = event->pos(); // 更新起始位置
-                m_pointsDirty = true;
-                update(); // 重绘
+                update(); // 重绘，已缓存的图块只需平移
             }
         }
     }
@@ -251,16 +468,15 @@ void PlotWidget::mouseReleaseEvent(QMouseEvent *event)
 
 void PlotWidget::wheelEvent(QWheelEvent *event)
 {
-    // 缩放功能
-    const double scaleFactor = 1.15;
+    // 缩放功能：按级别缩放，图块按级别缓存
     QPointF mousePos = event->posF();
     QPointF oldWorldPos = screenToWorld(mousePos);
 
     if (event->angleDelta().y() > 0) {
-        m_scale *= scaleFactor;
+        setZoomLevel(m_zoomLevel + 1);
 
     } else {
-        m_scale /= scaleFactor;
+        setZoomLevel(m_zoomLevel - 1);
     }
 
     int height = this->height();
@@ -274,7 +490,7 @@ void PlotWidget::wheelEvent(QWheelEvent *event)
     // 以鼠标位置为中心缩放
 //    m_offset += mousePos - newScreenPos;
 
-    invalidatePoints();
+    update();
 
 //    update();
 }
@@ -321,7 +537,7 @@ void PlotWidget::mouseDoubleClickEvent(QMouseEvent *event)
             int pointIndex = findPointAtPosition(event->pos());
 
             if (pointIndex >= 0) {
-                QString lineId = m_dataPointData->points[pointIndex].lineId;
+                QString lineId = m_dataPointData->points.lineId(pointIndex);
                 emit pointDoubleClicked(lineId);
             } else {
 //                clearStatusBar();
@@ -332,10 +548,14 @@ void PlotWidget::mouseDoubleClickEvent(QMouseEvent *event)
 
 void PlotWidget::highlightLine(QString originalLineId)
 {
-    for (int i = 0; i < m_dataPointData->points.size(); i++) {
-        const DataPoint& currentDataPoint = m_dataPointData->points[i];
-        if (currentDataPoint.isVisible && currentDataPoint.lineId == originalLineId) {
-            highlightPoints.append(currentDataPoint);
+    // 只遍历这条线的各段
+    const PointStore& points = m_dataPointData->points;
+    const QVector<LineRun> runs = m_dataPointData->getLineRuns(originalLineId);
+    for (const LineRun &run : runs) {
+        for (int i = run.begin; i < run.end; ++i) {
+            if (points.isVisible(i)) {
+                highlightPoints.append(i);
+            }
         }
     }
     update();
@@ -358,8 +578,11 @@ void PlotWidget::highlightLine(QString originalLineId)
 
 void PlotWidget::drawHighlightPoints(QPainter &painter)
 {
-    for (DataPoint& point : highlightPoints) {
-        QPointF screenPos = worldToScreen(point.coordinate);
+    const LocalTransform toScreen = localTransform();
+    const float *localX = m_dataPointData->localX();
+    const float *localY = m_dataPointData->localY();
+    for (int index : highlightPoints) {
+        QPointF screenPos = toScreen.map(localX[index], localY[index]);
         painter.setPen(QPen(m_highlightColor, 1));
         painter.setBrush(QBrush(m_highlightColor));
         painter.drawEllipse(screenPos, m_pointRadius+4, m_pointRadius+4);
@@ -377,6 +600,16 @@ QPointF PlotWidget::worldToScreen(const QPointF &worldPoint) const
     return QPointF(x, y);
 }
 
+PlotWidget::LocalTransform PlotWidget::localTransform() const
+{
+    const QPointF origin = worldToScreen(m_dataPointData->localOrigin());
+    LocalTransform transform;
+    transform.scale = m_scale;
+    transform.originX = origin.x();
+    transform.originY = origin.y();
+    return transform;
+}
+
 QPointF PlotWidget::screenToWorld(const QPointF &screenPoint) const
 {
 //    return QPointF((screenPoint.x() - m_offset.x()) / m_scale,
@@ -400,21 +633,28 @@ void PlotWidget::updateDataRect()
     if (!m_dataPointData || m_dataPointData->points.isEmpty())
         return;
 
-    double minX = m_dataPointData->points[0].coordinate.x();
-    double maxX = minX;
-    double minY = m_dataPointData->points[0].coordinate.y();
-    double maxY = minY;
+    // 在局部坐标上求范围，最后加上原点
+    const PointStore &points = m_dataPointData->points;
+    const float *xs = m_dataPointData->localX();
+    const float *ys = m_dataPointData->localY();
+    const PointBitset &visible = points.visibility();
+
+    float minX = xs[0];
+    float maxX = minX;
+    float minY = ys[0];
+    float maxY = minY;
 
-    for (const DataPoint &point : m_dataPointData->points) {
-        if (!point.isVisible) continue;
+    for (int i = 0; i < points.size(); ++i) {
+        if (!visible.test(i)) continue;
 
-        minX = qMin(minX, point.coordinate.x());
-        maxX = qMax(maxX, point.coordinate.x());
-        minY = qMin(minY, point.coordinate.y());
-        maxY = qMax(maxY, point.coordinate.y());
+        minX = qMin(minX, xs[i]);
+        maxX = qMax(maxX, xs[i]);
+        minY = qMin(minY, ys[i]);
+        maxY = qMax(maxY, ys[i]);
     }
 
-    m_dataRect = QRectF(minX, minY, maxX - minX, maxY - minY);
+    const QPointF origin = m_dataPointData->localOrigin();
+    m_dataRect = QRectF(origin.x() + minX, origin.y() + minY, double(maxX) - minX, double(maxY) - minY);
 }
 
 ///drawLines的功能已并入drawPoints中
@@ -453,58 +693,6 @@ void PlotWidget::updateDataRect()
 //    }
 //}
 
-void PlotWidget::drawPoints(QPainter &painter)
-{
-    if (!m_dataPointData)
-        return;
-
-//    for (const DataPoint &point : m_dataPointData->points) {
-//        if (!point.isVisible) continue;
-
-//        QPointF screenPos = worldToScreen(point.coordinate);
-
-//        // 根据质量选择颜色
-//        QColor color = ((point.alt >= m_dataPointData->lowAltThreshold)
-//                        && (point.alt <= m_dataPointData->highAltThreshold))
-//                        ?m_normalAltColor : m_abnormalAltColor;
-
-//        painter.setPen(QPen(color, 1));
-//        painter.setBrush(QBrush(color));
-
-//        // 绘制小圆点
-//        painter.drawEllipse(screenPos, 3, 3);
-//    }
-
-    DataPoint lastDataPoint = m_dataPointData->points[0];
-    QPointF lastScreenPos = worldToScreen(lastDataPoint.coordinate);
-    if (lastDataPoint.isVisible) {
-        QColor color = lastDataPoint.isNormalAlt ?m_normalAltColor : m_abnormalAltColor;
-        painter.setPen(QPen(color, 1));
-        painter.setBrush(QBrush(color));
-        painter.drawEllipse(lastScreenPos, m_pointRadius, m_pointRadius);
-    }
-    for (int i = 1; i < m_dataPointData->points.size(); ++i) {
-        const DataPoint& currentDataPoint = m_dataPointData->points[i];
-        QPointF currentScreenPos = worldToScreen(currentDataPoint.coordinate);
-
-        if (currentDataPoint.isVisible) {
-            QColor color = currentDataPoint.isNormalAlt ?m_normalAltColor : m_abnormalAltColor;
-            painter.setPen(QPen(color, 1));
-            painter.setBrush(QBrush(color));
-            painter.drawEllipse(currentScreenPos, m_pointRadius, m_pointRadius);
-        }
-        if (lastDataPoint.isVisible && currentDataPoint.isVisible
-                && (lastDataPoint.fn + 20 > currentDataPoint.fn)
-                && (lastDataPoint.lineId == currentDataPoint.lineId)) {
-            painter.setPen(QPen(m_lineSegmentColor, 1));
-            painter.setBrush(QBrush(m_lineSegmentColor));
-            painter.drawLine(currentScreenPos, lastScreenPos);
-        }
-        lastDataPoint = currentDataPoint;
-        lastScreenPos = currentScreenPos;
-    }
-}
-
 void PlotWidget::drawDesignLines(QPainter &painter)
 {
     if (m_designLinesFile.size() < 1) return;
@@ -556,53 +744,59 @@ void PlotWidget::drawGrid(QPainter &painter)
     }
 }
 
-QVector<LineSegment> PlotWidget::getQualitySegmentedLines() const
+QVector<LineSegment> PlotWidget::getQualitySegmentedLines(QVector<int> &indices) const
 {
     QVector<LineSegment> segments;
+    indices.clear();
 
     if (!m_dataPointData)
         return segments;
 
-    // 遍历每条线
-    for (auto it = m_dataPointData->lineMap.begin(); it != m_dataPointData->lineMap.end(); ++it) {
-        const QString &lineNumber = it.key();
-        const QVector<int> &pointIndices = it.value();
-
-        if (pointIndices.size() < 2) continue;
+    const PointStore &points = m_dataPointData->points;
+    const LineIndex &lineMap = m_dataPointData->lineMap;
 
+    // 遍历每条线
+    for (int lineCode = 0; lineCode < lineMap.codeCount(); ++lineCode) {
         LineSegment currentSegment;
-        currentSegment.lineId = lineNumber;
-
-        for (int idx : pointIndices) {
-            if (idx >= m_dataPointData->points.size()) continue;
-
-            const DataPoint &point = m_dataPointData->points[idx];
-            if (!point.isVisible) continue;
-
-            bool isHighQuality = (point.alt >= m_dataPointData->lowAltThreshold)
-                                && (point.alt <= m_dataPointData->highAltThreshold);
-
-            // 如果质量状态改变，开始新的段
-            if (!currentSegment.pointIndices.isEmpty() &&
-                currentSegment.hasNormalAlt != isHighQuality) {
-
-                if (currentSegment.pointIndices.size() >= 2) {
-                    segments.append(currentSegment);
+        currentSegment.lineCode = lineCode;
+        currentSegment.first = indices.size();
+
+        for (int r = lineMap.firstRun(lineCode); r >= 0; r = lineMap.nextRun(r)) {
+            const LineRun &run = lineMap.run(r);
+            for (int idx = run.begin; idx < run.end; ++idx) {
+                if (!points.isVisible(idx)) continue;
+
+                bool isHighQuality = (points.alt(idx) >= m_dataPointData->lowAltThreshold)
+                                    && (points.alt(idx) <= m_dataPointData->highAltThreshold);
+
+                // 如果质量状态改变，开始新的段，不足两点的段从缓冲中退回
+                if (currentSegment.count > 0 &&
+                    currentSegment.hasNormalAlt != isHighQuality) {
+
+                    if (currentSegment.count >= 2) {
+                        segments.append(currentSegment);
+                    } else {
+                        indices.resize(currentSegment.first);
+                    }
+
+                    currentSegment = LineSegment();
+                    currentSegment.lineCode = lineCode;
+                    currentSegment.hasNormalAlt = isHighQuality;
+                    currentSegment.first = indices.size();
+                } else if (currentSegment.count == 0) {
+                    currentSegment.hasNormalAlt = isHighQuality;
                 }
 
-                currentSegment = LineSegment();
-                currentSegment.lineId = lineNumber;
-                currentSegment.hasNormalAlt = isHighQuality;
-            } else if (currentSegment.pointIndices.isEmpty()) {
-                currentSegment.hasNormalAlt = isHighQuality;
+                indices.append(idx);
+                ++currentSegment.count;
             }
-
-            currentSegment.pointIndices.append(idx);
         }
 
         // 添加最后一个段
-        if (currentSegment.pointIndices.size() >= 2) {
+        if (currentSegment.count >= 2) {
             segments.append(currentSegment);
+        } else {
+            indices.resize(currentSegment.first);
         }
     }
 
@@ -625,10 +819,12 @@ bool PlotWidget::isPointSelected(const QPointF &point) const
 
 int PlotWidget::findPointAtPosition(const QPointF &pos) const   //输入的pos是屏幕坐标
 {
-    for (int i = 0; i < m_dataPointData->points.size(); ++i) {
-        const DataPoint& point = m_dataPointData->points[i];
-        QPointF widgetPos = point.coordinate;
-        widgetPos = worldToScreen(widgetPos);
+    const PointStore& points = m_dataPointData->points;
+    const LocalTransform toScreen = localTransform();
+    const float *xs = m_dataPointData->localX();
+    const float *ys = m_dataPointData->localY();
+    for (int i = 0; i < points.size(); ++i) {
+        QPointF widgetPos = toScreen.map(xs[i], ys[i]);
 
         // 计算鼠标位置与数据点的距离
         double distance = QLineF(pos, widgetPos).length();
@@ -6,7 +6,13 @@
 #include <QMouseEvent>
 #include <QRubberBand>
 #include <QTimer>
+#include <QCache>
+#include <QHash>
+#include <QImage>
+#include <QThreadPool>
 #include "datastructures.h"
+#include "pointpyramid.h"
+#include "tilerenderer.h"
 #include <QDebug>
 #include <QPolygonF>
 #include <QVector>
@@ -15,6 +21,27 @@
 
 class PolygonSelectionWidget;
 
+// 点图块的键：缩放级别、块号、数据版本（DataPointData::revision()）
+struct TileKey {
+    int zoom;
+    int tx;
+    int ty;
+    quint64 revision;
+
+    TileKey() : zoom(0), tx(0), ty(0), revision(0) {}
+    TileKey(int z, int x, int y, quint64 r) : zoom(z), tx(x), ty(y), revision(r) {}
+
+    bool operator==(const TileKey &other) const
+    {
+        return zoom == other.zoom && tx == other.tx && ty == other.ty && revision == other.revision;
+    }
+};
+
+inline uint qHash(const TileKey &key, uint seed = 0)
+{
+    return qHash(qMakePair(key.zoom, key.tx), seed) ^ qHash(qMakePair(key.ty, key.revision), seed + 1);
+}
+
 class PlotWidget : public QWidget
 {
     Q_OBJECT
@@ -32,6 +59,7 @@ public:
     };
 
     explicit PlotWidget(QWidget *parent = nullptr);
+    ~PlotWidget() override;
 
     // 设置数据
     void setBatchData(DataPointData *data);
@@ -49,7 +77,8 @@ public:
     // 缩放到适合大小
     void zoomToFit();
 
-    void updatePointsCache();
+    // 数据末尾追加了从first开始的点（跟踪文件增长时），增量画到已缓存的图块上
+    void appendPoints(int first);
 
     void setStatusBar(QStatusBar* statusBar) { m_statusBar = statusBar; }
 
@@ -88,7 +117,8 @@ private:
 
     // 视图变换
     QPointF m_offset;           // 偏移
-    double m_scale;             // 缩放比例
+    double m_scale;             // 缩放比例，为zoomStep的m_zoomLevel次方
+    int m_zoomLevel;            // 缩放级别，图块按级别缓存
     QRectF m_dataRect;          // 数据范围
 
     // 选择功能
@@ -118,8 +148,25 @@ private:
     bool isClickPending;
     static constexpr double dragThreshold = 5.0; // 拖动距离阈值（像素）
     static constexpr int clickTimeThreshold = 200; // 单击时间阈值（毫秒）
-
-    QPixmap m_pointsCache;      // 缓存数据点
+    static constexpr double zoomStep = 1.15;    // 滚轮每格的缩放倍数
+    static constexpr int minZoomLevel = -100;
+    static constexpr int maxZoomLevel = 70;
+
+    // 点图块缓存：局部坐标乘以缩放比例后按tileSize见方划分，图块与视图的平移无关，
+    // 平移、回到去过的位置或缩放级别时直接取用；按占用内存淘汰最久未用的图块
+    static constexpr int tileSize = 256;
+    static constexpr int tileCacheKB = 64 * 1024;   // 图块缓存上限
+    QCache<TileKey, QImage> m_tiles;
+    quint64 m_tileRevision = 0;         // 缓存中图块的数据版本
+    PointPyramid m_pyramid;     // 缩小显示时的各级抽稀点
+
+    // 后台绘制：图块在线程池中绘制，完成前先显示抽稀更多的粗略图块
+    static constexpr int frameBudgetMs = 12;    // 每帧当场绘制粗略图块的时间上限
+    static constexpr double coarseCellSize = 8; // 粗略图块抽稀的方格边长（像素）
+    static constexpr int coarseCacheKB = 16 * 1024;
+    QCache<TileKey, QImage> m_coarseTiles;
+    QHash<TileKey, QSharedPointer<QAtomicInt> > m_pendingTiles;    // 正在后台绘制的图块及其取消标志
+    QThreadPool m_renderPool;
 
     QStatusBar* m_statusBar = nullptr;
 
@@ -127,24 +174,56 @@ private:
     double m_pointRadius = 2.0;     // 数据点半径
     double m_clickTolerance = 4.0;   // 点击容差（像素）
 
-    QList<DataPoint> highlightPoints;
+    QVector<int> highlightPoints;   // 高亮显示的点的索引
 
     // 辅助函数
     QPointF worldToScreen(const QPointF &worldPoint) const;
+    // 架次局部坐标（localX/localY）到屏幕坐标的变换，逐点循环前取一次：
+    // 原点的屏幕位置先算好，每点只需一次乘加
+    struct LocalTransform {
+        double scale;
+        double originX;     // 局部原点的屏幕坐标
+        double originY;
+
+        QPointF map(float x, float y) const { return QPointF(originX + x * scale, originY - y * scale); }
+    };
+    LocalTransform localTransform() const;
     QPointF screenToWorld(const QPointF &screenPoint) const;
     QRectF screenToWorld(const QRectF &screenRect) const;
 
     void updateDataRect();
 //    void drawLines(QPainter &painter);
-    void drawPoints(QPainter &painter);
+    // 当前视图下的绘制快照
+    PointScene pointScene() const;
+    // 屏幕范围screenRect内要画的点，level为抽稀级别，小于0时按网格取出全部点
+    PointSelection selectPoints(const QRectF &screenRect, int level);
+    // 设置缩放级别，m_scale随之改变
+    void setZoomLevel(int level);
+    // 绘制视口内的图块，没有缓存的交给后台绘制，并预取四周一圈
+    void drawTiles(QPainter &painter);
+    // 屏幕范围覆盖的图块号范围（含两端）
+    QRect tileRange(const QRect &screenRect) const;
+    // 图块在当前视图中的屏幕位置
+    QRectF tileRect(int tx, int ty) const;
+    TileKey tileKey(int tx, int ty) const { return TileKey(m_zoomLevel, tx, ty, m_tileRevision); }
+    // 交给线程池绘制一块，已在绘制中时不重复提交
+    void requestTile(const TileKey &key, const PointScene &scene);
+    // 当场绘制一块粗略图块；放大到不需抽稀时点很少，直接画完整的图块
+    QImage *renderCoarseTile(const TileKey &key, const PointScene &scene);
+    // 后台绘制完成（在界面线程中调用）
+    void onTileRendered(const TileKey &key, const QImage &image);
+    // 取消视口及四周范围keep以外、或缩放级别和数据版本已变的后台绘制
+    void cancelStaleTiles(const QRect &keep);
+    // 丢弃全部图块并取消后台绘制
+    void discardTiles();
     void drawHighlightPoints(QPainter &painter);
 //    void drawSelectionRegions(QPainter &painter);
     void drawGrid(QPainter &painter);
 
     void drawDesignLines(QPainter &painter);
 
-    // 获取线段（考虑质量分段）
-    QVector<LineSegment> getQualitySegmentedLines() const;
+    // 获取线段（考虑质量分段），各段的点索引写入indices
+    QVector<LineSegment> getQualitySegmentedLines(QVector<int> &indices) const;
 
     // 检查点是否在选择区域内
     bool isPointSelected(const QPointF &point) const;
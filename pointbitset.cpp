@@ -0,0 +1,199 @@
+#include "pointbitset.h"
+#include <QtAlgorithms>
+#include <cstring>
+
+PointBitset::PointBitset()
+    : m_size(0)
+    , m_count(0)
+    , m_indexDirty(false)
+{
+}
+
+void PointBitset::resize(int size, bool value)
+{
+    const int oldSize = m_size;
+    m_words.resize((size + 63) / 64);
+    m_size = size;
+    m_indexDirty = true;
+
+    if (size < oldSize) {
+        clearTail();
+        m_count = 0;
+        for (quint64 word : m_words)
+            m_count += int(qPopulationCount(word));
+        return;
+    }
+    if (!value || size == oldSize)
+        return;
+
+    // 先补齐原末尾不足一个字的部分，再整字置位
+    int i = oldSize;
+    for (; i < size && (i & 63); ++i)
+        m_words[i >> 6] |= quint64(1) << (i & 63);
+    for (int w = i >> 6; i < size && w < m_words.size(); ++w)
+        m_words[w] = ~quint64(0);
+    clearTail();
+    m_count += size - oldSize;
+}
+
+void PointBitset::append(bool value)
+{
+    if ((m_size & 63) == 0)
+        m_words.append(0);
+    if (value) {
+        m_words.last() |= quint64(1) << (m_size & 63);
+        ++m_count;
+    }
+    ++m_size;
+    m_indexDirty = true;
+}
+
+void PointBitset::append(const PointBitset &other)
+{
+    if (other.m_size == 0)
+        return;
+
+    const int base = m_size >> 6;
+    const int shift = m_size & 63;
+    m_words.resize((m_size + other.m_size + 63) / 64);
+    quint64 *words = m_words.data();
+    if (shift == 0) {
+        memcpy(words + base, other.words(), size_t(other.wordCount()) * sizeof(quint64));
+    } else {
+        for (int j = 0; j < other.wordCount(); ++j) {
+            const quint64 w = other.m_words.at(j);
+            words[base + j] |= w << shift;
+            if (base + j + 1 < m_words.size())
+                words[base + j + 1] |= w >> (64 - shift);
+        }
+    }
+    m_size += other.m_size;
+    m_count += other.m_count;
+    m_indexDirty = true;
+}
+
+PointBitset PointBitset::mid(int first) const
+{
+    PointBitset result;
+    if (first >= m_size)
+        return result;
+    if (first <= 0)
+        return *this;
+
+    result.resize(m_size - first);
+    const int base = first >> 6;
+    const int shift = first & 63;
+    quint64 *words = result.m_words.data();
+    for (int j = 0; j < result.m_words.size(); ++j) {
+        quint64 w = m_words.at(base + j) >> shift;
+        if (shift && base + j + 1 < m_words.size())
+            w |= m_words.at(base + j + 1) << (64 - shift);
+        words[j] = w;
+    }
+    result.clearTail();
+    for (quint64 word : result.m_words)
+        result.m_count += int(qPopulationCount(word));
+    return result;
+}
+
+void PointBitset::set(int i, bool value)
+{
+    quint64 &word = m_words[i >> 6];
+    const quint64 bit = quint64(1) << (i & 63);
+    if (bool(word & bit) == value)
+        return;
+    if (value) {
+        word |= bit;
+        ++m_count;
+    } else {
+        word &= ~bit;
+        --m_count;
+    }
+    m_indexDirty = true;
+}
+
+void PointBitset::fill(bool value)
+{
+    m_words.fill(value ? ~quint64(0) : 0);
+    clearTail();
+    m_count = value ? m_size : 0;
+    m_indexDirty = true;
+}
+
+int PointBitset::rank(int i) const
+{
+    if (i <= 0)
+        return 0;
+    if (i >= m_size)
+        return m_count;
+    if (m_indexDirty)
+        buildIndex();
+
+    const int word = i >> 6;
+    int result = m_blockRanks.at(word / BlockWords);
+    for (int w = word - word % BlockWords; w < word; ++w)
+        result += int(qPopulationCount(m_words.at(w)));
+    if (i & 63)
+        result += int(qPopulationCount(m_words.at(word) & ((quint64(1) << (i & 63)) - 1)));
+    return result;
+}
+
+int PointBitset::select(int k) const
+{
+    if (k < 0 || k >= m_count)
+        return -1;
+    if (m_indexDirty)
+        buildIndex();
+
+    // 由抽样确定所在块的范围，在范围内二分
+    const int sample = k / SelectSample;
+    int lo = m_selectSamples.at(sample);
+    int hi = (sample + 1 < m_selectSamples.size()) ? m_selectSamples.at(sample + 1)
+                                                    : m_blockRanks.size() - 2;
+    while (lo < hi) {
+        const int mid = (lo + hi + 1) / 2;
+        if (m_blockRanks.at(mid) <= k)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+
+    int remaining = k - m_blockRanks.at(lo);
+    const int end = qMin((lo + 1) * int(BlockWords), m_words.size());
+    for (int w = lo * BlockWords; w < end; ++w) {
+        quint64 word = m_words.at(w);
+        const int bits = int(qPopulationCount(word));
+        if (remaining < bits) {
+            for (; remaining > 0; --remaining)
+                word &= word - 1;
+            return (w << 6) + int(qCountTrailingZeroBits(word));
+        }
+        remaining -= bits;
+    }
+    return -1;
+}
+
+void PointBitset::clearTail()
+{
+    if (m_size & 63)
+        m_words.last() &= (quint64(1) << (m_size & 63)) - 1;
+}
+
+void PointBitset::buildIndex() const
+{
+    const int blocks = (m_words.size() + BlockWords - 1) / BlockWords;
+    m_blockRanks.resize(blocks + 1);
+    m_selectSamples.clear();
+
+    int running = 0;
+    for (int b = 0; b < blocks; ++b) {
+        m_blockRanks[b] = running;
+        const int end = qMin((b + 1) * int(BlockWords), m_words.size());
+        for (int w = b * BlockWords; w < end; ++w)
+            running += int(qPopulationCount(m_words.at(w)));
+        while (m_selectSamples.size() * SelectSample < running)
+            m_selectSamples.append(b);
+    }
+    m_blockRanks[blocks] = running;
+    m_indexDirty = false;
+}
@@ -0,0 +1,54 @@
+#ifndef POINTBITSET_H
+#define POINTBITSET_H
+
+#include <QVector>
+#include <QtGlobal>
+
+// 每点一位的位图，带rank/select索引
+// rank(i)为[0, i)中置位的个数，select(k)为第k个置位的下标，
+// 用于可见点在全部点中的下标与表格行号之间的互相换算，不必为每个可见点存一个int
+// 修改位后索引在下次查询时重建一次（每64位一个字，每8个字一块，重建只需遍历各字）
+class PointBitset
+{
+public:
+    PointBitset();
+
+    int size() const { return m_size; }
+    // 置位的个数，随修改同步更新，不需要重建索引
+    int count() const { return m_count; }
+
+    // 调整位数，新增的位取value
+    void resize(int size, bool value = false);
+    void append(bool value);
+    void append(const PointBitset &other);
+    PointBitset mid(int first) const;
+
+    bool test(int i) const { return (m_words.at(i >> 6) >> (i & 63)) & 1; }
+    void set(int i, bool value);
+    void fill(bool value);
+
+    // [0, i)中置位的个数，i可以等于size()
+    int rank(int i) const;
+    // 第k个（从0开始）置位的下标，k超出count()时返回-1
+    int select(int k) const;
+
+    // 按字遍历，末尾不足64位的部分恒为0
+    const quint64 *words() const { return m_words.constData(); }
+    int wordCount() const { return m_words.size(); }
+
+private:
+    enum { BlockWords = 8, SelectSample = 4096 };
+
+    void clearTail();
+    void buildIndex() const;
+
+    QVector<quint64> m_words;
+    int m_size;
+    int m_count;
+
+    mutable QVector<int> m_blockRanks;      // 各块之前的置位个数，末尾多一项为总数
+    mutable QVector<int> m_selectSamples;   // 第j*SelectSample个置位所在的块
+    mutable bool m_indexDirty;
+};
+
+#endif // POINTBITSET_H
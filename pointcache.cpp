@@ -0,0 +1,256 @@
+#include "pointcache.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <climits>
+#include <cstring>
+
+namespace {
+
+const char CacheMagic[4] = { 'L', 'E', 'P', 'C' };
+const quint32 CacheVersion = 2;
+
+// 抽样哈希时分别取文件开头、中间、结尾各这么多字节
+const qint64 HashSampleBytes = 64 * 1024;
+
+// 缓存文件头，其后依次为：
+//   qint64 rowOffset[rowCount]
+//   quint64 keyBlock[blockCount]   主键指纹各块的哈希，blockCount由rowCount按块行数算出
+//   double x[rowCount], y[rowCount], alt[rowCount]
+//   qint32 fn[rowCount]
+//   CachedLineRun runs[runCount]
+//   char   text[textBytes]    各段线号的UTF-8文本，按段顺序首尾相接
+// 均为本机字节序，文件头长度为8的倍数，映射后各列按自然边界对齐
+struct CacheHeader {
+    char magic[4];
+    quint32 version;
+    qint64 sourceSize;
+    qint64 sourceModified;      // 修改时间（毫秒时间戳）
+    quint64 sourceHash;
+    qint32 columns[DatParsePlan::FieldCount];
+    qint32 runCount;
+    qint64 rowCount;
+    qint64 textBytes;
+};
+static_assert(sizeof(CacheHeader) == 72, "CacheHeader layout changed");
+
+// 线号相同的连续点合为一段
+struct CachedLineRun {
+    qint32 rowCount;
+    qint32 textLength;
+};
+
+quint64 fnv1a(quint64 hash, const char *p, qint64 length)
+{
+    for (qint64 i = 0; i < length; ++i) {
+        hash ^= uchar(p[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// 只对开头、中间和结尾抽样，大文件也能很快算完；大小和修改时间同时参与校验
+quint64 sampledHash(const MappedDatFile &source)
+{
+    const char *data = source.data();
+    const qint64 size = source.size();
+    quint64 hash = 14695981039346656037ULL;
+    if (size <= 3 * HashSampleBytes)
+        return fnv1a(hash, data, size);
+
+    hash = fnv1a(hash, data, HashSampleBytes);
+    hash = fnv1a(hash, data + (size - HashSampleBytes) / 2, HashSampleBytes);
+    return fnv1a(hash, data + size - HashSampleBytes, HashSampleBytes);
+}
+
+CacheHeader makeHeader(const MappedDatFile &source, const DatParsePlan &plan)
+{
+    CacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CacheMagic, sizeof(CacheMagic));
+    header.version = CacheVersion;
+    header.sourceSize = source.size();
+    header.sourceModified = QFileInfo(source.filePath()).lastModified().toMSecsSinceEpoch();
+    header.sourceHash = sampledHash(source);
+    for (int f = 0; f < DatParsePlan::FieldCount; ++f)
+        header.columns[f] = plan.columns[f];
+    return header;
+}
+
+bool sameSource(const CacheHeader &a, const CacheHeader &b)
+{
+    if (memcmp(a.magic, b.magic, sizeof(a.magic)) != 0 || a.version != b.version)
+        return false;
+    if (a.sourceSize != b.sourceSize || a.sourceModified != b.sourceModified
+            || a.sourceHash != b.sourceHash)
+        return false;
+    return memcmp(a.columns, b.columns, sizeof(a.columns)) == 0;
+}
+
+qint64 keyBlockCount(qint64 rowCount)
+{
+    return (rowCount + KeyFingerprint::BlockRows - 1) / KeyFingerprint::BlockRows;
+}
+
+qint64 expectedSize(const CacheHeader &header)
+{
+    return qint64(sizeof(CacheHeader))
+            + header.rowCount * qint64(sizeof(qint64) + 3 * sizeof(double) + sizeof(qint32))
+            + keyBlockCount(header.rowCount) * qint64(sizeof(quint64))
+            + qint64(header.runCount) * qint64(sizeof(CachedLineRun))
+            + header.textBytes;
+}
+
+template <typename T>
+bool writeArray(QSaveFile &file, const T *values, int count)
+{
+    const qint64 bytes = qint64(count) * qint64(sizeof(T));
+    return file.write(reinterpret_cast<const char *>(values), bytes) == bytes;
+}
+
+template <typename T>
+bool writeArray(QSaveFile &file, const QVector<T> &values)
+{
+    return writeArray(file, values.constData(), values.size());
+}
+
+}
+
+QString PointCache::cachePath(const QString &sourcePath)
+{
+    return sourcePath + ".lecache";
+}
+
+bool PointCache::load(const MappedDatFile &source, const DatParsePlan &plan, PointStore &points,
+                      QVector<qint64> *rowOffsets, KeyFingerprint *keys)
+{
+    QFile file(cachePath(source.filePath()));
+    if (!file.exists() || !file.open(QIODevice::ReadOnly))
+        return false;
+    if (file.size() < qint64(sizeof(CacheHeader)))
+        return false;
+
+    uchar *map = file.map(0, file.size());
+    if (!map)
+        return false;
+
+    CacheHeader header;
+    memcpy(&header, map, sizeof(header));
+    if (!sameSource(header, makeHeader(source, plan))
+            || header.rowCount < 0 || header.rowCount > INT_MAX / 2
+            || header.runCount < 0 || header.textBytes < 0
+            || expectedSize(header) != file.size()) {
+        qDebug() << "点缓存已失效:" << file.fileName();
+        file.unmap(map);
+        return false;
+    }
+
+    const int rows = int(header.rowCount);
+    const char *p = reinterpret_cast<const char *>(map) + sizeof(CacheHeader);
+    const qint64 *offsets = reinterpret_cast<const qint64 *>(p);
+    p += qint64(rows) * sizeof(qint64);
+    const int blockCount = int(keyBlockCount(rows));
+    const quint64 *keyBlocks = reinterpret_cast<const quint64 *>(p);
+    p += qint64(blockCount) * sizeof(quint64);
+    const double *xs = reinterpret_cast<const double *>(p);
+    const double *ys = xs + rows;
+    const double *alts = ys + rows;
+    const qint32 *fns = reinterpret_cast<const qint32 *>(alts + rows);
+    const CachedLineRun *runs = reinterpret_cast<const CachedLineRun *>(fns + rows);
+    const char *text = reinterpret_cast<const char *>(runs + header.runCount);
+    const char *textEnd = text + header.textBytes;
+
+    PointStore loaded;
+    loaded.reserve(rows);
+    int row = 0;
+    for (int r = 0; r < header.runCount; ++r) {
+        const CachedLineRun &run = runs[r];
+        if (run.rowCount < 0 || run.textLength < 0 || run.rowCount > rows - row
+                || run.textLength > textEnd - text) {
+            qWarning() << "点缓存已损坏:" << file.fileName();
+            file.unmap(map);
+            return false;
+        }
+
+        // 缓存与内存中的点同为按列存放，每段整块复制
+        const int lineCode = loaded.internLine(QString::fromUtf8(text, run.textLength));
+        text += run.textLength;
+        loaded.append(lineCode, run.rowCount, fns + row, xs + row, ys + row, alts + row);
+        row += run.rowCount;
+    }
+    QVector<qint64> loadedOffsets;
+    if (rowOffsets && row == rows) {
+        loadedOffsets.resize(rows);
+        memcpy(loadedOffsets.data(), offsets, size_t(rows) * sizeof(qint64));
+    }
+    KeyFingerprint loadedKeys;
+    if (keys && row == rows) {
+        loadedKeys.rows = rows;
+        loadedKeys.blockHashes.resize(blockCount);
+        memcpy(loadedKeys.blockHashes.data(), keyBlocks, size_t(blockCount) * sizeof(quint64));
+    }
+    file.unmap(map);
+
+    if (row != rows) {
+        qWarning() << "点缓存已损坏:" << file.fileName();
+        return false;
+    }
+    points.append(loaded);
+    if (rowOffsets)
+        rowOffsets->swap(loadedOffsets);
+    if (keys)
+        *keys = loadedKeys;
+    return true;
+}
+
+bool PointCache::save(const MappedDatFile &source, const DatParsePlan &plan, const PointStore &points,
+                      const QVector<qint64> &rowOffsets, const KeyFingerprint &keys)
+{
+    if (rowOffsets.size() != points.size() || keys.rows != points.size()
+            || keys.blockHashes.size() != keyBlockCount(points.size()))
+        return false;
+
+    // 坐标、高度、点号各列直接写出，只需按线号编码分段
+    const int rows = points.size();
+    QVector<CachedLineRun> runs;
+    QByteArray text;
+    for (int i = 0; i < rows; ++i) {
+        if (i == 0 || points.lineCode(i) != points.lineCode(i - 1)) {
+            const QByteArray id = points.lineId(i).toUtf8();
+            CachedLineRun run;
+            run.rowCount = 0;
+            run.textLength = id.size();
+            runs.append(run);
+            text.append(id);
+        }
+        ++runs.last().rowCount;
+    }
+
+    CacheHeader header = makeHeader(source, plan);
+    header.rowCount = rows;
+    header.runCount = runs.size();
+    header.textBytes = text.size();
+
+    // 先写临时文件再替换，写到一半失败不会留下损坏的缓存
+    QSaveFile file(cachePath(source.filePath()));
+    if (!file.open(QIODevice::WriteOnly)) {
+        qDebug() << "无法写入点缓存:" << file.fileName();
+        return false;
+    }
+    bool ok = file.write(reinterpret_cast<const char *>(&header), sizeof(header)) == qint64(sizeof(header))
+            && writeArray(file, rowOffsets)
+            && writeArray(file, keys.blockHashes)
+            && writeArray(file, points.xData(), rows) && writeArray(file, points.yData(), rows)
+            && writeArray(file, points.altData(), rows)
+            && writeArray(file, points.fnData(), rows)
+            && writeArray(file, runs)
+            && file.write(text) == text.size();
+    if (!ok) {
+        file.cancelWriting();
+        qDebug() << "无法写入点缓存:" << file.fileName();
+        return false;
+    }
+    return file.commit();
+}
@@ -0,0 +1,27 @@
+#ifndef POINTCACHE_H
+#define POINTCACHE_H
+
+#include <QString>
+#include <QVector>
+#include "datastructures.h"
+#include "datreader.h"
+
+// 解析结果的二进制旁路缓存，与DAT文件放在同一目录（文件名加.lecache后缀）
+// 按列存放线号、点号、X、Y、高度、每个点所在行的字节偏移以及按原始字节计算的主键指纹，
+// 以源文件大小、修改时间、抽样哈希和解析列号作为键，任一变化即失效
+namespace PointCache {
+
+QString cachePath(const QString &sourcePath);
+
+// 缓存有效时映射缓存文件并读出全部点，无缓存或已失效时返回false
+// rowOffsets非空时同时读出各点所在行相对于文件开头的字节偏移，keys非空时同时读出主键指纹
+bool load(const MappedDatFile &source, const DatParsePlan &plan, PointStore &points,
+          QVector<qint64> *rowOffsets = nullptr, KeyFingerprint *keys = nullptr);
+
+// 写入缓存，rowOffsets为各点所在行相对于文件开头的字节偏移，keys为解析时得到的主键指纹
+bool save(const MappedDatFile &source, const DatParsePlan &plan, const PointStore &points,
+          const QVector<qint64> &rowOffsets, const KeyFingerprint &keys);
+
+}
+
+#endif // POINTCACHE_H
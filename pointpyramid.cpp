@@ -0,0 +1,87 @@
+#include "pointpyramid.h"
+#include "datastructures.h"
+#include <cmath>
+
+namespace {
+
+// 与PointRenderer::drawRange的连线条件一致：点号差小于此值的相邻两点连线
+const int MaxJoinedFnStep = 20;
+
+}
+
+void PointPyramid::clear()
+{
+    m_levels.clear();
+    m_built.clear();
+    m_revision = 0;
+}
+
+int PointPyramid::levelFor(double cellSize)
+{
+    if (!(cellSize >= 2))
+        return -1;
+    return qMin(int(std::floor(std::log2(cellSize))), int(MaxLevel));
+}
+
+const QVector<PointPyramid::Entry> &PointPyramid::level(const DataPointData &data, int level)
+{
+    if (m_levels.isEmpty()) {
+        m_levels.resize(MaxLevel + 1);
+        m_built.fill(false, MaxLevel + 1);
+    }
+    if (data.revision() != m_revision) {
+        m_built.fill(false);
+        m_revision = data.revision();
+    }
+
+    level = qBound(0, level, int(MaxLevel));
+    if (!m_built.at(level)) {
+        build(data, level, m_levels[level]);
+        m_built[level] = true;
+    }
+    return m_levels.at(level);
+}
+
+void PointPyramid::build(const DataPointData &data, int level, QVector<Entry> &out) const
+{
+    out.clear();
+
+    const PointStore &points = data.points;
+    const float *xs = data.localX();
+    const float *ys = data.localY();
+    const int *fns = points.fnData();
+    const int *lineCodes = points.lineCodeData();
+    const quint8 *flags = points.flagData();
+    const PointBitset &visibility = points.visibility();
+    const double cellSize = std::ldexp(1.0, level);
+
+    int lastKept = -1;
+    qint64 lastColumn = 0;
+    qint64 lastRow = 0;
+    bool joined = false;        // 上一个保留点到当前点之间是否一直相连
+    for (int i = 0; i < points.size(); ++i) {
+        if (!visibility.test(i)) {
+            joined = false;
+            continue;
+        }
+        if (i > 0) {
+            joined = joined && lineCodes[i - 1] == lineCodes[i]
+                    && fns[i - 1] + MaxJoinedFnStep > fns[i];
+        }
+
+        const qint64 column = qint64(std::floor(xs[i] / cellSize));
+        const qint64 row = qint64(std::floor(ys[i] / cellSize));
+        const bool keep = lastKept < 0 || !joined
+                || !(flags[i] & PointStore::NormalAlt)
+                || column != lastColumn || row != lastRow;
+        if (!keep)
+            continue;
+
+        out.append(Entry(i, joined));
+        lastKept = i;
+        lastColumn = column;
+        lastRow = row;
+        joined = true;
+    }
+    out.squeeze();
+}
@@ -0,0 +1,44 @@
+#ifndef POINTPYRAMID_H
+#define POINTPYRAMID_H
+
+#include <QVector>
+#include <QtGlobal>
+
+class DataPointData;
+
+// 缩小显示用的多级抽稀点
+// 第level级按边长2^level（局部坐标单位，米）的方格分桶，同一条线上连续落在同一格中的
+// 可见点只保留第一个；高度异常的点和断线后的第一个点全部保留，缩得再小也不会消失
+// 各级在第一次用到时生成，数据版本（DataPointData::revision()）改变后重新生成
+class PointPyramid
+{
+public:
+    enum { MaxLevel = 30 };
+
+    struct Entry {
+        int index;      // 点下标
+        bool joined;    // 与上一个保留点之间各点依次相连（同一线号、可见、点号连续），绘制时连线
+
+        Entry() : index(0), joined(false) {}
+        Entry(int i, bool j) : index(i), joined(j) {}
+    };
+
+    PointPyramid() : m_revision(0) {}
+
+    void clear();
+
+    // 方格不大于cellSize的最粗一级，cellSize小于2时返回-1，表示不必抽稀
+    static int levelFor(double cellSize);
+
+    // 第level级的保留点，按下标升序
+    const QVector<Entry> &level(const DataPointData &data, int level);
+
+private:
+    void build(const DataPointData &data, int level, QVector<Entry> &out) const;
+
+    QVector<QVector<Entry> > m_levels;
+    QVector<bool> m_built;
+    quint64 m_revision;         // 各级生成时的数据版本
+};
+
+#endif // POINTPYRAMID_H
@@ -0,0 +1,170 @@
+#include "pointstore.h"
+#include "datastructures.h"
+#include <cstring>
+
+namespace {
+
+// 新追加的点缺省可见、高度正常，与DataPoint的缺省值一致
+const quint8 DefaultFlags = PointStore::NormalAlt;
+
+template <typename T>
+void appendArray(QVector<T> &column, const T *values, int count)
+{
+    const int first = column.size();
+    column.resize(first + count);
+    memcpy(column.data() + first, values, size_t(count) * sizeof(T));
+}
+
+}
+
+void PointStore::reserve(int size)
+{
+    m_x.reserve(size);
+    m_y.reserve(size);
+    m_alt.reserve(size);
+    m_fn.reserve(size);
+    m_lineCode.reserve(size);
+    m_flags.reserve(size);
+}
+
+void PointStore::clear()
+{
+    m_x.clear();
+    m_y.clear();
+    m_alt.clear();
+    m_fn.clear();
+    m_lineCode.clear();
+    m_flags.clear();
+    m_visible = PointBitset();
+    m_lineNames.clear();
+    m_lineCodes.clear();
+}
+
+void PointStore::append(int lineCode, int fn, double x, double y, double alt)
+{
+    m_x.append(x);
+    m_y.append(y);
+    m_alt.append(alt);
+    m_fn.append(fn);
+    m_lineCode.append(lineCode);
+    m_flags.append(DefaultFlags);
+    m_visible.append(true);
+}
+
+void PointStore::append(const DataPoint &point)
+{
+    append(internLine(point.lineId), point.fn, point.coordinate.x(), point.coordinate.y(), point.alt);
+    if (!point.isVisible)
+        m_visible.set(size() - 1, false);
+    if (!point.isNormalAlt)
+        m_flags.last() &= quint8(~NormalAlt);
+}
+
+void PointStore::append(int lineCode, int count, const int *fns, const double *xs, const double *ys,
+                        const double *alts)
+{
+    if (count <= 0)
+        return;
+    appendArray(m_x, xs, count);
+    appendArray(m_y, ys, count);
+    appendArray(m_alt, alts, count);
+    appendArray(m_fn, fns, count);
+    m_lineCode.insert(m_lineCode.size(), count, lineCode);
+    m_flags.insert(m_flags.size(), count, DefaultFlags);
+    m_visible.resize(m_visible.size() + count, true);
+}
+
+void PointStore::append(const PointStore &other)
+{
+    if (other.isEmpty())
+        return;
+    if (isEmpty() && m_lineNames.isEmpty()) {
+        *this = other;
+        return;
+    }
+
+    // 线号表很小，先换算编码，再整列复制
+    QVector<int> codeMap(other.lineCount());
+    for (int code = 0; code < other.lineCount(); ++code)
+        codeMap[code] = internLine(other.lineName(code));
+
+    const int count = other.size();
+    appendArray(m_x, other.xData(), count);
+    appendArray(m_y, other.yData(), count);
+    appendArray(m_alt, other.altData(), count);
+    appendArray(m_fn, other.fnData(), count);
+    appendArray(m_flags, other.flagData(), count);
+    m_visible.append(other.m_visible);
+
+    const int first = m_lineCode.size();
+    m_lineCode.resize(first + count);
+    int *codes = m_lineCode.data() + first;
+    const int *otherCodes = other.lineCodeData();
+    for (int i = 0; i < count; ++i)
+        codes[i] = codeMap[otherCodes[i]];
+}
+
+void PointStore::removeLast()
+{
+    if (isEmpty())
+        return;
+    m_x.removeLast();
+    m_y.removeLast();
+    m_alt.removeLast();
+    m_fn.removeLast();
+    m_lineCode.removeLast();
+    m_flags.removeLast();
+    m_visible.resize(m_visible.size() - 1);
+}
+
+PointStore PointStore::mid(int first) const
+{
+    if (first <= 0)
+        return *this;
+
+    PointStore result;
+    result.m_x = m_x.mid(first);
+    result.m_y = m_y.mid(first);
+    result.m_alt = m_alt.mid(first);
+    result.m_fn = m_fn.mid(first);
+    result.m_lineCode = m_lineCode.mid(first);
+    result.m_flags = m_flags.mid(first);
+    result.m_visible = m_visible.mid(first);
+    result.m_lineNames = m_lineNames;
+    result.m_lineCodes = m_lineCodes;
+    return result;
+}
+
+DataPoint PointStore::at(int i) const
+{
+    DataPoint point(lineId(i), m_fn.at(i), m_x.at(i), m_y.at(i), m_alt.at(i));
+    point.isVisible = isVisible(i);
+    point.isNormalAlt = isNormalAlt(i);
+    return point;
+}
+
+int PointStore::internLine(const QString &lineId)
+{
+    auto it = m_lineCodes.constFind(lineId);
+    if (it != m_lineCodes.constEnd())
+        return it.value();
+
+    const int code = m_lineNames.size();
+    m_lineNames.append(lineId);
+    m_lineCodes.insert(lineId, code);
+    return code;
+}
+
+void PointStore::renameLine(int code, const QString &lineId)
+{
+    m_lineCodes.remove(m_lineNames.at(code));
+    m_lineNames[code] = lineId;
+    m_lineCodes.insert(lineId, code);
+}
+
+void PointStore::setAllLineIds(const QString &lineId)
+{
+    m_lineNames.clear();
+    m_lineCodes.clear();
+    m_lineCode.fill(internLine(lineId));
+}
@@ -0,0 +1,111 @@
+#ifndef POINTSTORE_H
+#define POINTSTORE_H
+
+#include <QHash>
+#include <QPointF>
+#include <QString>
+#include <QVector>
+#include "pointbitset.h"
+
+struct DataPoint;
+
+// 按列存放的数据点：X、Y、高度、点号各是一个连续数组，线号存为线号表中的编码，
+// 可见性为每点一位的位图，其余标志位打包为一个字节
+// 线号表每个架次一份，逐点比较、分段和索引都用整数编码，只在显示和导出时取线号文本
+// 替代QList<DataPoint>（Qt5中每个DataPoint单独占一个堆节点，并各带一个QString），
+// 每点约33字节，逐点遍历时只读取用到的列
+// 各列为隐式共享的QVector，复制整个PointStore不复制数据
+class PointStore
+{
+public:
+    enum Flag {
+        NormalAlt = 0x01    // 高度是否正常
+    };
+
+    int size() const { return m_fn.size(); }
+    bool isEmpty() const { return m_fn.isEmpty(); }
+    void reserve(int size);
+    void clear();
+
+    // 追加一个点，线号编码须来自本对象的线号表（internLine()）
+    void append(int lineCode, int fn, double x, double y, double alt);
+    void append(const DataPoint &point);
+    // 追加同一线号的count个点，各列从连续数组整块复制
+    void append(int lineCode, int count, const int *fns, const double *xs, const double *ys,
+                const double *alts);
+    // 追加另一组点，线号编码按本对象的线号表重新映射
+    void append(const PointStore &other);
+    void removeLast();
+
+    // 从first开始的点（含线号表），用于取出新解析的一段
+    PointStore mid(int first) const;
+
+    // 按行取出单个点，只用于界面显示和项目保存等非逐点循环的场合
+    DataPoint at(int i) const;
+
+    double x(int i) const { return m_x.at(i); }
+    double y(int i) const { return m_y.at(i); }
+    QPointF coordinate(int i) const { return QPointF(m_x.at(i), m_y.at(i)); }
+    double alt(int i) const { return m_alt.at(i); }
+    int fn(int i) const { return m_fn.at(i); }
+    int lineCode(int i) const { return m_lineCode.at(i); }
+    const QString &lineId(int i) const { return m_lineNames.at(m_lineCode.at(i)); }
+    void setLineId(int i, const QString &lineId) { m_lineCode[i] = internLine(lineId); }
+    void setLineCode(int i, int code) { m_lineCode[i] = code; }
+
+    bool isVisible(int i) const { return m_visible.test(i); }
+    bool isNormalAlt(int i) const { return m_flags.at(i) & NormalAlt; }
+    void setVisible(int i, bool visible) { m_visible.set(i, visible); }
+    void setNormalAlt(int i, bool normal) { setFlag(i, NormalAlt, normal); }
+    void setAllVisible(bool visible) { m_visible.fill(visible); }
+    // 整体替换可见性位图，位数须与点数相同
+    void setVisibility(const PointBitset &visible) { m_visible = visible; }
+
+    // 可见点的个数（位图中置位的个数，不逐点统计）
+    int visibleCount() const { return m_visible.count(); }
+    // 第k个可见点在全部点中的下标，k超出范围时返回-1
+    int visibleIndex(int k) const { return m_visible.select(k); }
+    // 下标i之前的可见点个数，i可见时即为它在可见点中的序号
+    int visibleRank(int i) const { return m_visible.rank(i); }
+    const PointBitset &visibility() const { return m_visible; }
+
+    // 线号表：同一线号只存一份，各点只记编码
+    int lineCount() const { return m_lineNames.size(); }
+    const QString &lineName(int code) const { return m_lineNames.at(code); }
+    // 线号对应的编码，线号表中没有时新增
+    int internLine(const QString &lineId);
+    // 线号对应的编码，没有时返回-1
+    int findLine(const QString &lineId) const { return m_lineCodes.value(lineId, -1); }
+    // 改名只改线号表中的一项，使用该编码的点随之改变；lineId不能已在线号表中
+    void renameLine(int code, const QString &lineId);
+    // 所有点改为同一个线号，线号表只剩这一项
+    void setAllLineIds(const QString &lineId);
+
+    // 各列的连续数组，供逐点遍历的循环直接读取
+    const double *xData() const { return m_x.constData(); }
+    const double *yData() const { return m_y.constData(); }
+    const double *altData() const { return m_alt.constData(); }
+    const int *fnData() const { return m_fn.constData(); }
+    const int *lineCodeData() const { return m_lineCode.constData(); }
+    const quint8 *flagData() const { return m_flags.constData(); }
+
+private:
+    void setFlag(int i, Flag flag, bool on)
+    {
+        quint8 &flags = m_flags[i];
+        flags = on ? quint8(flags | flag) : quint8(flags & ~flag);
+    }
+
+    QVector<double> m_x;
+    QVector<double> m_y;
+    QVector<double> m_alt;
+    QVector<int> m_fn;
+    QVector<int> m_lineCode;
+    QVector<quint8> m_flags;
+    PointBitset m_visible;
+
+    QVector<QString> m_lineNames;           // 编码 -> 线号
+    QHash<QString, int> m_lineCodes;        // 线号 -> 编码
+};
+
+#endif // POINTSTORE_H
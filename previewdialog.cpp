@@ -1,4 +1,6 @@
 #include "previewdialog.h"
+#include "gzipreader.h"
+#include "datscanner.h"
 #include <QMessageBox>
 #include <QLabel>
 #include <QtWidgets>
@@ -227,12 +229,13 @@ void PreviewDialog::setupStep2()
 
 void PreviewDialog::loadFilePreview()
 {
-    QFile file(m_fileName);
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+    // gzip压缩文件只解压预览所需的开头部分
+    QScopedPointer<QIODevice> file(createDatDevice(m_fileName));
+    if (!file->open(QIODevice::ReadOnly | QIODevice::Text)) {
         QMessageBox::warning(this, "错误", "无法打开文件: " + m_fileName);
         return;
     }
-    QTextStream in(&file);
+    QTextStream in(file.data());
     in.setCodec("UTF-8");
     m_originalData.clear();
 
@@ -245,19 +248,11 @@ void PreviewDialog::loadFilePreview()
         lineCount++;
     }
 
-    int colSize = lastLine.split(' ', QString::SkipEmptyParts).size();
-    int headerLines = 0;
-    for (const QString &line : m_originalData)
-    {
-        if (line.split(' ', QString::SkipEmptyParts).size() == colSize)
-        {
-            break;
-        }
-        else headerLines ++;
-    }
+    // 表头位置与导入时一致，由扫描服务按LINE行识别，结果留给后续导入使用
+    DatLayout layout = DatScanner::instance().header(m_fileName);
 //    m_skipLinesSpinBox->setValue(headerLines);
-    m_skipLines = headerLines;
-    file.close();
+    m_skipLines = layout.hasHeader() ? qMin(layout.headerLine, m_originalData.size()) : 0;
+    file->close();
 }
 
 void PreviewDialog::updateDataPreview()
@@ -324,7 +319,8 @@ void PreviewDialog::parseHeaders()
         else if (header == "fn")    m_pointNumberCombo->setCurrentIndex(i + 1);
         else if (header == "x")     m_xCoordinateCombo->setCurrentIndex(i + 1);
         else if (header == "y")     m_yCoordinateCombo->setCurrentIndex(i + 1);
-        else if (header == "offset")    m_offsetCombo->setCurrentIndex(i + 1);
+        else if (header == "offset" || header == "ralt" || header == "alt")
+            m_offsetCombo->setCurrentIndex(i + 1);
     }
 }
 
@@ -19,24 +19,11 @@
 #include <QGroupBox>
 #include <QComboBox>
 #include <QTableWidget>
+#include "datastructures.h"
 
 class PreviewTextEdit;
 class LineNumberArea;
 
-struct ColumnMapping{
-    int lineIdColumn = -1;
-    int fnColumn = -1;
-    int xCoordinateColumn = -1;
-    int yCoordinateColumn = -1;
-    int offsetColumn = -1;
-
-    bool isValid() const{
-        return lineIdColumn >= 0 && fnColumn >= 0 &&
-                xCoordinateColumn >= 0 && yCoordinateColumn >= 0 &&
-                offsetColumn >= 0;
-    }
-};
-
 class PreviewDialog : public QDialog
 {
     Q_OBJECT
@@ -1,4 +1,5 @@
 #include "projectmanager.h"
+#include "datscanner.h"
 #include <QWidget>
 #include <QDir>
 #include <QInputDialog>
@@ -71,6 +72,7 @@ bool ProjectManager::openProject()
     } else {
         delete m_currentProject;
         m_currentProject = nullptr;
+        DatScanner::instance().releaseAll();
         QMessageBox::warning(m_parent, "错误", "无法加载项目文件！");
         return false;
     }
@@ -124,6 +126,7 @@ void ProjectManager::closeProject()
     if (m_currentProject) {
         delete m_currentProject;
         m_currentProject = nullptr;
+        DatScanner::instance().releaseAll();
         m_currentProjectFile.clear();
         m_isModified = false;
         m_currentProject = new ProjectModel(this);
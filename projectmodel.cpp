@@ -4,8 +4,14 @@
 #include <QDir>
 #include <QDebug>
 #include <QMessageBox>
-
-ProjectModel::ProjectModel(QObject *parent) : QObject(parent)
+#include <QHash>
+#include "datreader.h"
+#include "numparse.h"
+#include "pointcache.h"
+#include "gzipreader.h"
+#include "datscanner.h"
+
+ProjectModel::ProjectModel(QObject *parent) : QObject(parent), m_compactPoints(false)
 {
     createdTime = QDateTime::currentDateTime();
     lastModified = createdTime;
@@ -33,6 +39,7 @@ bool ProjectModel::loadProject(const QString& filePath) {
     projectName = root["projectName"].toString();
     createdTime = QDateTime::fromString(root["createdTime"].toString(), Qt::ISODate);
     lastModified = QDateTime::fromString(root["lastModified"].toString(), Qt::ISODate);
+    m_compactPoints = root["compactPoints"].toBool(false);
 
     // 加载设计线
     m_designLinesFile.clear();
@@ -46,6 +53,25 @@ bool ProjectModel::loadProject(const QString& filePath) {
     QJsonArray batchesArray = root["batches"].toArray();
     for (const auto& item : batchesArray) {
         m_batches.append(Batch::fromJson(item.toObject()));
+        if (m_compactPoints) {
+            m_batches.last().data->compact();
+        }
+    }
+
+    // 恢复文件扫描结果，文件未变化时不必重新扫描即可校验
+    QHash<QString, ColumnMapping> mappings;
+    for (const auto& batch : m_batches) {
+        for (const auto& dataFile : batch.filePaths) {
+            mappings.insert(QFileInfo(dataFile).absoluteFilePath(), batch.columnMapping);
+        }
+    }
+    QJsonArray scanCacheArray = root["scanCache"].toArray();
+    for (const auto& item : scanCacheArray) {
+        QJsonObject obj = item.toObject();
+        QString path = obj["path"].toString();
+        if (mappings.contains(path)) {
+            DatScanner::instance().restore(path, obj, mappings.value(path));
+        }
     }
 
     projectPath = filePath;
@@ -68,6 +94,7 @@ bool ProjectModel::saveProject(const QString& filePath) {
     root["projectName"] = projectName;
     root["createdTime"] = createdTime.toString(Qt::ISODate);
     root["lastModified"] = lastModified.toString(Qt::ISODate);
+    root["compactPoints"] = m_compactPoints;
 
     // 保存设计线
     QJsonArray designLinesArray;
@@ -76,13 +103,25 @@ bool ProjectModel::saveProject(const QString& filePath) {
     }
     root["designLines"] = designLinesArray;
 
-    // 保存批次
+    // 保存批次，保存后各架次的修改登记清零
     QJsonArray batchesArray;
     for (const auto& batch : m_batches) {
         batchesArray.append(batch.toJson());
     }
     root["batches"] = batchesArray;
 
+    // 保存架次中各文件的扫描结果（行数和主键指纹，不含各行偏移）
+    QJsonArray scanCacheArray;
+    for (const auto& batch : m_batches) {
+        for (const auto& dataFile : batch.filePaths) {
+            QJsonObject obj = DatScanner::instance().toJson(dataFile);
+            if (obj.isEmpty()) continue;
+            obj["path"] = QFileInfo(dataFile).absoluteFilePath();
+            scanCacheArray.append(obj);
+        }
+    }
+    root["scanCache"] = scanCacheArray;
+
     QJsonDocument doc(root);
     QFile file(savePath);
 
@@ -97,6 +136,9 @@ bool ProjectModel::saveProject(const QString& filePath) {
     if (projectPath.isEmpty()) {
         projectPath = savePath;
     }
+    for (const auto& batch : m_batches) {
+        batch.data->clearDirty();
+    }
 
     emit projectModified();
     return true;
@@ -216,8 +258,8 @@ QJsonObject Batch::toJson() const {
     json["fileNames"] = filesArray;
 
     QJsonArray pointsArray;
-    for (const auto& point : points) {
-        pointsArray.append(point.toJson());
+    for (int i = 0; i < data->pointCount(); ++i) {
+        pointsArray.append(data->pointAt(i).toJson());
     }
     json["points"] = pointsArray;
 
@@ -228,6 +270,19 @@ QJsonObject Batch::toJson() const {
     json["relatedLines"] = linesArray;
 
     json["fileLineCount"] = size;
+    if (parsedBytes >= 0) {
+        json["parsedBytes"] = double(parsedBytes);
+    }
+
+    if (columnMapping.isValid()) {
+        QJsonObject mappingObj;
+        mappingObj["line"] = columnMapping.lineIdColumn;
+        mappingObj["fn"] = columnMapping.fnColumn;
+        mappingObj["x"] = columnMapping.xCoordinateColumn;
+        mappingObj["y"] = columnMapping.yCoordinateColumn;
+        mappingObj["alt"] = columnMapping.offsetColumn;
+        json["columnMapping"] = mappingObj;
+    }
 
     return json;
 }
@@ -236,6 +291,14 @@ Batch Batch::fromJson(const QJsonObject& json) {
     Batch batch;
     batch.batchName = json["batchName"].toString();
     batch.size = json["fileLineCount"].toInt(0);
+    batch.parsedBytes = qint64(json["parsedBytes"].toDouble(-1));
+
+    QJsonObject mappingObj = json["columnMapping"].toObject();
+    batch.columnMapping.lineIdColumn = mappingObj["line"].toInt(-1);
+    batch.columnMapping.fnColumn = mappingObj["fn"].toInt(-1);
+    batch.columnMapping.xCoordinateColumn = mappingObj["x"].toInt(-1);
+    batch.columnMapping.yCoordinateColumn = mappingObj["y"].toInt(-1);
+    batch.columnMapping.offsetColumn = mappingObj["alt"].toInt(-1);
 
     QJsonArray filesArray = json["fileNames"].toArray();
     for (const auto& item : filesArray) {
@@ -243,9 +306,12 @@ Batch Batch::fromJson(const QJsonObject& json) {
     }
 
     QJsonArray pointsArray = json["points"].toArray();
+    PointStore points;
+    points.reserve(pointsArray.size());
     for (const auto& item : pointsArray) {
-        batch.points.append(DataPoint::fromJson(item.toObject()));
+        points.append(DataPoint::fromJson(item.toObject()));
     }
+    batch.data->addPoints(points);
 
     QJsonArray linesArray = json["relatedLines"].toArray();
     for (const auto& item : linesArray) {
@@ -289,13 +355,13 @@ bool ProjectModel::addDesignLineFile(const QString& filePath) {
             // 按空格分割数据
             QStringList parts1 = line1.split(QRegExp("\\s+"), QString::SkipEmptyParts);
             QStringList parts2 = line2.split(QRegExp("\\s+"), QString::SkipEmptyParts);
-            if (parts1.size() >= 3) {
+            if (parts1.size() >= 3 && parts2.size() >= 3) {
                 DesignLine dl;
-                dl.lineName = parts1[0].trimmed();
-                dl.x1 = parts1[1].trimmed().toDouble();
-                dl.y1 = parts1[2].trimmed().toDouble();
-                dl.x2 = parts2[1].trimmed().toDouble();
-                dl.y2 = parts2[2].trimmed().toDouble();
+                dl.lineName = parts1[0];
+                dl.x1 = NumParse::toDouble(parts1[1]);
+                dl.y1 = NumParse::toDouble(parts1[2]);
+                dl.x2 = NumParse::toDouble(parts2[1]);
+                dl.y2 = NumParse::toDouble(parts2[2]);
                 dl.matchTimes = 0;
 
                 newFile.data.append(dl);
@@ -359,6 +425,9 @@ bool ProjectModel::addBatch(const QString& batchName) {
 
 bool ProjectModel::removeBatch(int index) {
     if (index >= 0 && index < m_batches.size()) {
+        for (const auto& dataFile : m_batches[index].filePaths) {
+            DatScanner::instance().release(dataFile);
+        }
         m_batches.removeAt(index);
         lastModified = QDateTime::currentDateTime();
         emit batchesChanged();
@@ -368,77 +437,83 @@ bool ProjectModel::removeBatch(int index) {
     return false;
 }
 
-bool ProjectModel::addDataFile(int batchIndex, const QString& filePath) {
+int ProjectModel::findBatch(const QString& batchName) const {
+    for (int i = 0; i < m_batches.size(); ++i) {
+        if (m_batches[i].batchName == batchName) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool ProjectModel::canAddDataFile(int batchIndex, const QString& filePath) {
     if (batchIndex < 0 || batchIndex >= m_batches.size()) {
         return false;
     }
 
-//    QFileInfo fileInfo(filePath);
-//    QString fileName = fileInfo.fileName();
-
-    Batch& batch = m_batches[batchIndex];
-
     // 检查文件是否已添加到该批次
-    for (const auto& f : batch.filePaths) {
+    for (const auto& f : m_batches[batchIndex].filePaths) {
         if (f == filePath) {
             QMessageBox::warning(nullptr, "重复导入",
                                  QString("文件 [%1] 已经导入过了！").arg(filePath));
             return false;
         }
     }
+    return true;
+}
 
-    // 检查行数约束
-    if (batch.size == 0) {
-        // 第一个文件，设置行数约束，解析坐标到Datapoints和relatedLines
+bool ProjectModel::commitParsedDataFile(int batchIndex, const QString& filePath, const PointStore& points,
+                                        const ColumnMapping& mapping, qint64 parsedEnd) {
+    if (batchIndex < 0 || batchIndex >= m_batches.size()) {
+        return false;
+    }
 
-        QFile file(filePath);
-        if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-            QMessageBox::warning(nullptr, "错误", "无法打开文件 ");
-            return false;
-        }
-        QTextStream in(&file);
-        in.setCodec("UTF-8");
-        QStringList previewData;
-        QString lastLine;
+    Batch& batch = m_batches[batchIndex];
+    if (batch.size != 0) {
+        // 解析期间架次已有了首个文件
+        qDebug() << "架次已有数据，放弃解析结果:" << filePath;
+        return false;
+    }
 
-        // 跳过头部
-        while (!in.atEnd()) {
-            lastLine = in.readLine().trimmed();
-            if (lastLine.split(' ', QString::SkipEmptyParts)[0] == "LINE")
-                break;
-        }
-        while (!in.atEnd()){
-            lastLine = in.readLine().trimmed();
-            QStringList parts = lastLine.split(' ', QString::SkipEmptyParts);
-            if (parts.size() >= 8) {
-                DataPoint dp;
-                dp.lineId = parts[0].trimmed();
-                dp.fn = parts[1].trimmed().toInt();
-                dp.coordinate = QPointF(parts[4].trimmed().toDouble(),
-                        parts[5].trimmed().toDouble());
-                dp.alt = parts[7].trimmed().toDouble();
-                dp.isVisible = true;
-                batch.points.append(dp);
-                batch.size ++;
-            }
-        }
-        file.close();
-    } else {
-        // 非本架次第一个文件，只检查行数约束，添加文件名，不添加点数据
-        // 获取文件行数
-        int size = getSize(filePath);
-        if (size <= 0) {
-            qDebug() << "文件为空或无法读取";
-            return false;
-        }
-        if (batch.size != size) {
-            // 行数不匹配，返回false
-            QMessageBox::warning(nullptr, "大小不匹配",
-                             QString("文件 [%1] 与已有文件 [%2] 大小不匹配").arg(filePath, batch.filePaths[0]));
+    batch.data->addPoints(points);
+    batch.size += points.size();
+    batch.parsedBytes = parsedEnd;
+    batch.filePaths.append(filePath);
+    batch.columnMapping = mapping;
+    // 刚导入的架次还没有打开
+    if (m_compactPoints) {
+        batch.data->compact();
+    }
+
+    lastModified = QDateTime::currentDateTime();
+    emit batchesChanged();
+    emit projectModified();
+    return true;
+}
+
+bool ProjectModel::commitCountedDataFile(int batchIndex, const QString& filePath, int size, qint64 divergingRow) {
+    if (batchIndex < 0 || batchIndex >= m_batches.size()) {
         return false;
-        }
     }
 
+    Batch& batch = m_batches[batchIndex];
+    if (size <= 0) {
+        qDebug() << "文件为空或无法读取";
+        return false;
+    }
+    if (batch.size != size) {
+        // 行数不匹配，返回false
+        QMessageBox::warning(nullptr, "大小不匹配",
+                             QString("文件 [%1] 与已有文件 [%2] 大小不匹配").arg(filePath, batch.filePaths.value(0)));
+        return false;
+    }
+    if (divergingRow >= 0) {
+        // 行数相同但记录没有逐行对应
+        QMessageBox::warning(nullptr, "数据不对应",
+                             QString("文件 [%1] 与已有文件 [%2] 从第 %3 个数据行起LINE/FN不一致")
+                             .arg(filePath, batch.filePaths.value(0)).arg(divergingRow + 1));
+        return false;
+    }
 
     batch.filePaths.append(filePath);
 
@@ -448,6 +523,23 @@ bool ProjectModel::addDataFile(int batchIndex, const QString& filePath) {
     return true;
 }
 
+void ProjectModel::setCompactPoints(bool compact) {
+    if (m_compactPoints == compact) {
+        return;
+    }
+    m_compactPoints = compact;
+    lastModified = QDateTime::currentDateTime();
+    emit projectModified();
+}
+
+void ProjectModel::markBatchModified(int batchIndex) {
+    if (batchIndex < 0 || batchIndex >= m_batches.size()) {
+        return;
+    }
+    lastModified = QDateTime::currentDateTime();
+    emit projectModified();
+}
+
 bool ProjectModel::removeDataFile(int batchIndex, int fileIndex) {
     if (batchIndex < 0 || batchIndex >= m_batches.size()) {
         return false;
@@ -459,12 +551,14 @@ bool ProjectModel::removeDataFile(int batchIndex, int fileIndex) {
         return false;
     }
 
+    DatScanner::instance().release(batch.filePaths[fileIndex]);
     batch.filePaths.removeAt(fileIndex);
 
     // 如果批次中已没有文件，重置行数约束
     if (batch.filePaths.isEmpty()) {
         batch.size = 0;
-        batch.points.clear();
+        batch.parsedBytes = -1;
+        batch.data->clear();
     }
 
     lastModified = QDateTime::currentDateTime();
@@ -473,28 +567,72 @@ bool ProjectModel::removeDataFile(int batchIndex, int fileIndex) {
     return true;
 }
 
-int ProjectModel::getSize(const QString& filePath) {
-    QFile file(filePath);
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        return -1;
+int ProjectModel::readDataPoints(const QString& filePath, const ColumnMapping& mapping,
+                                 PointStore& points, DatReader::ParseProgress *progress,
+                                 qint64 *parsedEnd) {
+    // 解析的同时得到文件布局，交给扫描服务，之后的校验和导出不再重读文件
+    DatLayout layout;
+    layout.mapping = mapping;
+    const int first = points.size();
+
+    // gzip压缩文件边解压边解析，不经过旁路缓存
+    if (isGzipFile(filePath)) {
+        int count = GzipDat::readPoints(filePath, mapping, points, progress, &layout);
+        if (layout.isScanned()) {
+            DatScanner::instance().store(filePath, layout);
+        }
+        return count;
     }
 
-    int size = 0;
-    QTextStream in(&file);
+    // 内存映射后直接在原始字节上解析，数据区分块并行解析
+    MappedDatFile datFile(filePath);
+    if (!datFile.open()) {
+        return -1;
+    }
+    layout.bodyEnd = datFile.size();
+    if (!datFile.hasBody() || !layout.readHeader(datFile.data(), datFile.bodyEnd())) {
+        layout.rows = 0;
+        layout.keys.rows = 0;
+        DatScanner::instance().store(filePath, layout);
+        return 0;
+    }
 
-    while (!in.atEnd()) {
-        QString lastLine = in.readLine().trimmed();
-        if (lastLine.split(' ', QString::SkipEmptyParts)[0] == "LINE")
-            break;
+    layout.plan = DatParsePlan::build(datFile, mapping);
+    if (parsedEnd) {
+        *parsedEnd = datFile.size();
     }
+    if (PointCache::load(datFile, layout.plan, points, &layout.rowOffsets, &layout.keys)) {
+        if (progress) {
+            progress->bytesProcessed.fetchAndAddRelaxed(datFile.size());
+            progress->rowsProcessed.fetchAndAddRelaxed(points.size() - first);
+        }
+    } else {
+        if (progress) {
+            progress->bytesProcessed.fetchAndAddRelaxed(datFile.bodyOffset());
+        }
+        // 主键指纹按线号的原始字节计算，与扫描其他文件时的结果可以直接比较
+        QVector<quint64> rowKeys;
+        int count = DatReader::parseRowsParallel(datFile.bodyBegin(), datFile.bodyEnd(), layout.plan,
+                                                 points, progress, &layout.rowOffsets, &rowKeys);
+        if (progress && progress->isCancelled()) {
+            return count;
+        }
 
-    while (!in.atEnd()) {
-        in.readLine();
-        size++;
+        // 行偏移换算为相对于文件开头
+        for (qint64 &offset : layout.rowOffsets) {
+            offset += datFile.bodyOffset();
+        }
+        DatReader::KeyFingerprinter fingerprinter(layout.plan);
+        for (quint64 rowKey : rowKeys) {
+            fingerprinter.addRowKey(rowKey);
+        }
+        layout.keys = fingerprinter.finish();
+        PointCache::save(datFile, layout.plan, points.mid(first), layout.rowOffsets, layout.keys);
     }
 
-    file.close();
-    return size;
+    layout.rows = points.size() - first;
+    DatScanner::instance().store(filePath, layout);
+    return int(layout.rows);
 }
 //QJsonObject ProjectModel::toJson() const
 //{
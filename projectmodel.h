@@ -7,8 +7,10 @@
 #include <QJsonObject>
 #include <QJsonDocument>
 #include <QJsonArray>
+#include <QSharedPointer>
 #include <datastructures.h>
 #include <QDebug>
+#include "datreader.h"
 
 // 设计线文件结构
 struct DesignLineFile {
@@ -24,9 +26,14 @@ struct DesignLineFile {
 struct Batch {
     QString batchName;
     QList<QString> filePaths;
-    QList<DataPoint> points;
+    // 点数据：打开的标签页直接引用这一份，编辑就地进行，不在两者之间整批复制
+    QSharedPointer<DataPointData> data;
     QList<QString> relatedLines;
     int size = 0; // 记录文件行数约束
+    qint64 parsedBytes = -1; // 首个文件已读入到的字节偏移，跟踪文件增长时从这里继续，-1表示未知
+    ColumnMapping columnMapping; // 首个文件的列映射，无效时按表头列名或缺省列解析
+
+    Batch() : data(new DataPointData) {}
 
     QJsonObject toJson() const;
     static Batch fromJson(const QJsonObject& json);
@@ -68,9 +75,30 @@ public:
     QList<Batch>& getBatches() { return m_batches; }
 
     // 测试线文件相关操作
-    bool addDataFile(int batchIndex, const QString& filePath);
     bool removeDataFile(int batchIndex, int fileIndex);
-    int getSize(const QString& filePath); // 获取文件行数
+
+    // 压缩驻留：不在当前标签页中显示的架次压缩存放点数据，随项目保存
+    // 打开或切换时由调用方对各架次调用DataPointData::compact()/expand()
+    bool compactPoints() const { return m_compactPoints; }
+    void setCompactPoints(bool compact);
+
+    // 标签页就地修改了架次的点数据后调用，修改已由DataPointData::markDirty()登记
+    void markBatchModified(int batchIndex);
+
+    // 后台导入：GUI线程先检查，工作线程解析或计数，完成后再由GUI线程提交结果
+    int findBatch(const QString& batchName) const;
+    bool canAddDataFile(int batchIndex, const QString& filePath);
+    // parsedEnd为解析到的字节偏移，-1表示未知
+    bool commitParsedDataFile(int batchIndex, const QString& filePath, const PointStore& points,
+                              const ColumnMapping& mapping = ColumnMapping(), qint64 parsedEnd = -1);
+    // divergingRow为与首个文件第一个LINE/FN不对应的数据行，-1表示逐行对应
+    bool commitCountedDataFile(int batchIndex, const QString& filePath, int size, qint64 divergingRow = -1);
+    // 读取首个文件的坐标点：旁路缓存有效时直接读缓存，否则解析文本并写缓存
+    // 解析时得到的文件布局交给DatScanner，返回点数，无法打开文件时返回-1
+    // parsedEnd非空时得到解析到的字节偏移（未压缩文件中读到表头时才有）
+    static int readDataPoints(const QString& filePath, const ColumnMapping& mapping,
+                              PointStore& points, DatReader::ParseProgress *progress = nullptr,
+                              qint64 *parsedEnd = nullptr);
 
     // 项目基本信息
     QString getProjectName() const { return projectName; }
@@ -94,6 +122,8 @@ signals:
 
 
 private:
+    bool m_compactPoints;
+
 //    QJsonObject toJson() const;
 //    void fromJson(const QJsonObject& json);
 };
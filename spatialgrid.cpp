@@ -0,0 +1,196 @@
+#include "spatialgrid.h"
+#include <QtAlgorithms>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// 平均每格的点数和每个方向的最大格数
+const int PointsPerCell = 64;
+const int MaxCells = 1024;
+
+// 坐标所在的格号，夹到[0, n)内
+int cellIndex(double offset, double cellSize, int n)
+{
+    const double cell = std::floor(offset / cellSize);
+    if (!(cell > 0))
+        return 0;
+    return cell < n ? int(cell) : n - 1;
+}
+
+}
+
+SpatialGrid::SpatialGrid()
+    : m_minX(0)
+    , m_minY(0)
+    , m_maxX(0)
+    , m_maxY(0)
+    , m_cellSize(1)
+    , m_columns(0)
+    , m_rows(0)
+    , m_size(0)
+    , m_builtSize(0)
+    , m_outside(0)
+{
+}
+
+void SpatialGrid::clear()
+{
+    m_runs.clear();
+    m_runCell.clear();
+    m_next.clear();
+    m_prev.clear();
+    m_first.clear();
+    m_last.clear();
+    m_columns = m_rows = 0;
+    m_size = 0;
+    m_builtSize = 0;
+    m_outside = 0;
+}
+
+void SpatialGrid::append(const float *xs, const float *ys, int first, int count)
+{
+    if (first >= count)
+        return;
+
+    // 点数翻倍或范围外的点超过八分之一时重建，重建的总开销与点数成正比
+    if (m_columns == 0 || count >= 2 * m_builtSize) {
+        rebuild(xs, ys, count);
+        return;
+    }
+
+    for (int i = first; i < count; ++i) {
+        if (isOutside(xs[i], ys[i]))
+            ++m_outside;
+    }
+    if (m_outside * 8 > count) {
+        rebuild(xs, ys, count);
+        return;
+    }
+
+    for (int i = first; i < count; ++i) {
+        const int cell = cellOf(xs[i], ys[i]);
+        const int last = m_last.at(cell);
+        if (last >= 0 && m_runs.at(last).end == i) {
+            ++m_runs[last].end;
+            continue;
+        }
+        const int r = m_runs.size();
+        m_runs.append(Range(i, i + 1));
+        m_runCell.append(cell);
+        m_next.append(-1);
+        m_prev.append(last);
+        if (last >= 0)
+            m_next[last] = r;
+        else
+            m_first[cell] = r;
+        m_last[cell] = r;
+    }
+    m_size = count;
+}
+
+void SpatialGrid::removeLast(float x, float y)
+{
+    // 末尾的点总在最后一段中
+    if (m_size == 0)
+        return;
+    if (isOutside(x, y))
+        --m_outside;
+    --m_size;
+
+    const int r = m_runs.size() - 1;
+    if (--m_runs[r].end > m_runs.at(r).begin)
+        return;
+
+    const int cell = m_runCell.at(r);
+    const int prev = m_prev.at(r);
+    if (prev >= 0)
+        m_next[prev] = -1;
+    else
+        m_first[cell] = -1;
+    m_last[cell] = prev;
+    m_runs.removeLast();
+    m_runCell.removeLast();
+    m_next.removeLast();
+    m_prev.removeLast();
+}
+
+void SpatialGrid::query(const QRectF &rect, QVector<Range> &ranges) const
+{
+    ranges.clear();
+    if (m_size == 0)
+        return;
+
+    // 视口包含整个网格时不必逐格收集
+    if (m_outside == 0 && rect.left() <= m_minX && rect.right() >= m_maxX
+            && rect.top() <= m_minY && rect.bottom() >= m_maxY) {
+        ranges.append(Range(0, m_size));
+        return;
+    }
+
+    const int left = cellIndex(rect.left() - m_minX, m_cellSize, m_columns);
+    const int right = cellIndex(rect.right() - m_minX, m_cellSize, m_columns);
+    const int top = cellIndex(rect.top() - m_minY, m_cellSize, m_rows);
+    const int bottom = cellIndex(rect.bottom() - m_minY, m_cellSize, m_rows);
+    for (int row = top; row <= bottom; ++row) {
+        for (int column = left; column <= right; ++column) {
+            for (int r = m_first.at(row * m_columns + column); r >= 0; r = m_next.at(r))
+                ranges.append(m_runs.at(r));
+        }
+    }
+
+    // 按下标排序后合并相接的段
+    std::sort(ranges.begin(), ranges.end(), [](const Range &a, const Range &b) {
+        return a.begin < b.begin;
+    });
+    int merged = 0;
+    for (int i = 1; i < ranges.size(); ++i) {
+        if (ranges.at(i).begin <= ranges.at(merged).end)
+            ranges[merged].end = qMax(ranges.at(merged).end, ranges.at(i).end);
+        else
+            ranges[++merged] = ranges.at(i);
+    }
+    ranges.resize(ranges.isEmpty() ? 0 : merged + 1);
+}
+
+void SpatialGrid::rebuild(const float *xs, const float *ys, int count)
+{
+    clear();
+
+    m_minX = m_maxX = xs[0];
+    m_minY = m_maxY = ys[0];
+    for (int i = 1; i < count; ++i) {
+        m_minX = qMin(m_minX, xs[i]);
+        m_maxX = qMax(m_maxX, xs[i]);
+        m_minY = qMin(m_minY, ys[i]);
+        m_maxY = qMax(m_maxY, ys[i]);
+    }
+
+    // 方格边长按平均每格PointsPerCell个点取，每个方向不超过MaxCells格
+    const double width = double(m_maxX) - m_minX;
+    const double height = double(m_maxY) - m_minY;
+    const double cells = qMax(1.0, double(count) / PointsPerCell);
+    double cellSize = std::sqrt(qMax(width * height, 0.0) / cells);
+    cellSize = qMax(cellSize, qMax(width, height) / MaxCells);
+    if (!(cellSize > 0))
+        cellSize = 1;
+    m_cellSize = float(cellSize);
+    m_columns = qBound(1, int(width / m_cellSize) + 1, MaxCells);
+    m_rows = qBound(1, int(height / m_cellSize) + 1, MaxCells);
+    m_first.fill(-1, m_columns * m_rows);
+    m_last.fill(-1, m_columns * m_rows);
+
+    m_builtSize = count;
+    append(xs, ys, 0, count);
+}
+
+bool SpatialGrid::isOutside(float x, float y) const
+{
+    return x < m_minX || x > m_maxX || y < m_minY || y > m_maxY;
+}
+
+int SpatialGrid::cellOf(float x, float y) const
+{
+    return cellIndex(double(y) - m_minY, m_cellSize, m_rows) * m_columns
+            + cellIndex(double(x) - m_minX, m_cellSize, m_columns);
+}
@@ -0,0 +1,62 @@
+#ifndef SPATIALGRID_H
+#define SPATIALGRID_H
+
+#include <QRectF>
+#include <QVector>
+
+// 按坐标划分的均匀网格，用于只取视口内的点
+// 航线上相邻的点多半落在同一格中，每格记录的是一段段下标连续的点[begin, end)，
+// 全部段存放在一个数组中，同一格的各段用下标串成链（与LineIndex相同）
+// 追加的点落在网格范围外时归入边上的格，查询时同样把范围夹到网格内，结果不会遗漏；
+// 范围外的点多了或点数翻倍时按全部点重建
+// 坐标为DataPointData的局部float坐标
+class SpatialGrid
+{
+public:
+    struct Range {
+        int begin;
+        int end;
+
+        Range() : begin(0), end(0) {}
+        Range(int b, int e) : begin(b), end(e) {}
+    };
+
+    SpatialGrid();
+
+    void clear();
+    int size() const { return m_size; }
+
+    // 追加了[first, count)的点，xs、ys为全部点的坐标
+    void append(const float *xs, const float *ys, int first, int count);
+    // 去掉末尾一个点，(x, y)为该点的坐标
+    void removeLast(float x, float y);
+
+    // rect内（及归入边格的范围外）的点，按下标升序合并为不重叠的段
+    // 结果可能多出同格中不在rect内的点，由绘制时裁剪
+    void query(const QRectF &rect, QVector<Range> &ranges) const;
+
+private:
+    void rebuild(const float *xs, const float *ys, int count);
+    bool isOutside(float x, float y) const;
+    int cellOf(float x, float y) const;
+
+    float m_minX;
+    float m_minY;
+    float m_maxX;
+    float m_maxY;
+    float m_cellSize;
+    int m_columns;
+    int m_rows;
+    int m_size;
+    int m_builtSize;        // 上次重建时的点数
+    int m_outside;          // 落在网格范围外的点数
+
+    QVector<Range> m_runs;      // 全部段，按下标升序
+    QVector<int> m_runCell;     // 各段所在的格
+    QVector<int> m_next;        // 同一格的下一段，-1为末段
+    QVector<int> m_prev;        // 同一格的上一段，-1为首段
+    QVector<int> m_first;       // 格 -> 首段，-1表示没有点
+    QVector<int> m_last;        // 格 -> 末段
+};
+
+#endif // SPATIALGRID_H
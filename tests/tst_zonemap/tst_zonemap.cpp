@@ -0,0 +1,92 @@
+#include <QtTest>
+#include <QPolygonF>
+#include "datastructures.h"
+
+// 分块摘要的范围判断，以及按选区隐藏点时的整块跳过
+class TestZoneMap : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void overlapsDegenerateBlock();
+    void hideByRegionNorthSouthLine();
+    void hideByRegionSinglePointTail();
+};
+
+namespace {
+
+// 南北向的一条线：X都为x，Y从y0起每点加1
+PointStore northSouthLine(int count, double x, double y0)
+{
+    PointStore points;
+    const int code = points.internLine("L1001");
+    for (int i = 0; i < count; ++i)
+        points.append(code, 100 + i, x, y0 + i, 100.0);
+    return points;
+}
+
+QPolygonF rectRegion(double left, double top, double right, double bottom)
+{
+    return QPolygonF() << QPointF(left, top) << QPointF(right, top)
+                       << QPointF(right, bottom) << QPointF(left, bottom);
+}
+
+}
+
+void TestZoneMap::overlapsDegenerateBlock()
+{
+    const PointStore points = northSouthLine(10, 500.0, 0.0);
+    ZoneMap zones;
+    zones.append(points, 0);
+    QCOMPARE(zones.blockCount(), 1);
+
+    // 外接矩形宽为0
+    const ZoneMap::Zone &zone = zones.zone(0);
+    QCOMPARE(zone.minX, zone.maxX);
+    QVERIFY(zone.overlaps(QRectF(400.0, 2.0, 200.0, 3.0)));
+    QVERIFY(!zone.overlaps(QRectF(501.0, 2.0, 10.0, 3.0)));
+    QVERIFY(!zone.overlaps(QRectF(400.0, 20.0, 200.0, 3.0)));
+    // 边界恰好落在线上也算相交
+    QVERIFY(zone.overlaps(QRectF(500.0, 2.0, 10.0, 3.0)));
+    QVERIFY(zone.overlaps(QRectF(400.0, 9.0, 100.0, 3.0)));
+}
+
+void TestZoneMap::hideByRegionNorthSouthLine()
+{
+    const int count = 3 * ZoneMap::BlockSize;
+    const QPolygonF region = rectRegion(400.0, -10.0, 600.0, count + 10.0);
+
+    DataPointData data;
+    data.addPoints(northSouthLine(count, 500.0, 0.0));
+    QCOMPARE(data.hideByRegion(region), count);
+    QCOMPARE(data.points.visibleCount(), 0);
+
+    // 反选时选区内的点都不隐藏
+    DataPointData inverted;
+    inverted.addPoints(northSouthLine(count, 500.0, 0.0));
+    QCOMPARE(inverted.hideByRegion(region, true), 0);
+    QCOMPARE(inverted.points.visibleCount(), count);
+}
+
+void TestZoneMap::hideByRegionSinglePointTail()
+{
+    // 末尾一块只有一个点，外接矩形宽高都为0
+    const int count = ZoneMap::BlockSize + 1;
+    const QPolygonF region = rectRegion(400.0, count - 1.5, 600.0, count + 10.0);
+
+    DataPointData data;
+    data.addPoints(northSouthLine(count, 500.0, 0.0));
+    QCOMPARE(data.zones.blockCount(), 2);
+    QCOMPARE(data.hideByRegion(region), 1);
+    QVERIFY(!data.points.isVisible(count - 1));
+    QVERIFY(data.points.isVisible(count - 2));
+
+    DataPointData inverted;
+    inverted.addPoints(northSouthLine(count, 500.0, 0.0));
+    QCOMPARE(inverted.hideByRegion(region, true), count - 1);
+    QVERIFY(inverted.points.isVisible(count - 1));
+}
+
+QTEST_APPLESS_MAIN(TestZoneMap)
+
+#include "tst_zonemap.moc"
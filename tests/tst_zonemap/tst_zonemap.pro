@@ -0,0 +1,32 @@
+QT       += core gui widgets testlib
+
+CONFIG += c++11 testcase
+CONFIG -= app_bundle
+
+TARGET = tst_zonemap
+
+INCLUDEPATH += ../..
+
+SOURCES += \
+    tst_zonemap.cpp \
+    ../../datastructures.cpp \
+    ../../lineindex.cpp \
+    ../../packedpoints.cpp \
+    ../../pointbitset.cpp \
+    ../../pointstore.cpp \
+    ../../spatialgrid.cpp \
+    ../../zonemap.cpp
+
+HEADERS += \
+    ../../datastructures.h \
+    ../../lineindex.h \
+    ../../packedpoints.h \
+    ../../pointbitset.h \
+    ../../pointstore.h \
+    ../../spatialgrid.h \
+    ../../zonemap.h
+
+msvc{
+    QMAKE_CFLAGS += /utf-8
+    QMAKE_CXXFLAGS += /utf-8
+}
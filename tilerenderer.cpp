@@ -0,0 +1,140 @@
+#include "tilerenderer.h"
+
+namespace {
+
+// 与前一点的点号差小于此值时连线
+const int MaxJoinedFnStep = 20;
+// 每画这么多个点检查一次是否已取消
+const int CancelCheckInterval = 1024;
+
+bool isCancelled(const QAtomicInt *cancelled)
+{
+    return cancelled && cancelled->loadAcquire() != 0;
+}
+
+}
+
+bool PointRenderer::draw(QPainter &painter, const PointSelection &selection, const QRectF &screenRect,
+                         const QAtomicInt *cancelled) const
+{
+    if (selection.thinned)
+        return drawEntries(painter, selection.entries, screenRect, cancelled);
+
+    // 每段向后多画一点，使连到范围外下一点的线段也画出
+    const int count = m_scene.points.size();
+    for (const SpatialGrid::Range &range : selection.ranges) {
+        if (!drawRange(painter, range.begin, qMin(range.end + 1, count), cancelled))
+            return false;
+    }
+    return true;
+}
+
+bool PointRenderer::drawRange(QPainter &painter, int first, int end, const QAtomicInt *cancelled) const
+{
+    const PointStore &points = m_scene.points;
+    if (first < 0 || first >= end || end > points.size())
+        return true;
+
+    // 按列读取，坐标用局部float坐标，线号只比较编码
+    const float *xs = m_scene.localX.constData();
+    const float *ys = m_scene.localY.constData();
+    const int *fns = points.fnData();
+    const int *lineCodes = points.lineCodeData();
+    const quint8 *flags = points.flagData();
+    const PointBitset &visibility = points.visibility();
+    const double radius = m_scene.pointRadius;
+
+    // 从first开始绘制，first之前的一个点只用于连线
+    int last = qMax(first - 1, 0);
+    QPointF lastScreenPos = map(xs, ys, last);
+    if (first == 0 && visibility.test(last)) {
+        QColor color = (flags[last] & PointStore::NormalAlt) ?m_scene.normalAltColor : m_scene.abnormalAltColor;
+        painter.setPen(QPen(color, 1));
+        painter.setBrush(QBrush(color));
+        painter.drawEllipse(lastScreenPos, radius, radius);
+    }
+    for (int i = qMax(first, 1); i < end; ++i) {
+        if ((i - first) % CancelCheckInterval == 0 && isCancelled(cancelled))
+            return false;
+
+        QPointF currentScreenPos = map(xs, ys, i);
+
+        const bool visible = visibility.test(i);
+        if (visible) {
+            QColor color = (flags[i] & PointStore::NormalAlt) ?m_scene.normalAltColor : m_scene.abnormalAltColor;
+            painter.setPen(QPen(color, 1));
+            painter.setBrush(QBrush(color));
+            painter.drawEllipse(currentScreenPos, radius, radius);
+        }
+        if (visibility.test(last) && visible
+                && (fns[last] + MaxJoinedFnStep > fns[i])
+                && (lineCodes[last] == lineCodes[i])) {
+            painter.setPen(QPen(m_scene.lineSegmentColor, 1));
+            painter.setBrush(QBrush(m_scene.lineSegmentColor));
+            painter.drawLine(currentScreenPos, lastScreenPos);
+        }
+        last = i;
+        lastScreenPos = currentScreenPos;
+    }
+    return true;
+}
+
+bool PointRenderer::drawEntries(QPainter &painter, const QVector<PointPyramid::Entry> &entries,
+                                const QRectF &screenRect, const QAtomicInt *cancelled) const
+{
+    const double radius = m_scene.pointRadius;
+    const QRectF drawRect = screenRect.adjusted(-radius - 1, -radius - 1, radius + 1, radius + 1);
+    const float *xs = m_scene.localX.constData();
+    const float *ys = m_scene.localY.constData();
+    const quint8 *flags = m_scene.points.flagData();
+
+    QPointF lastScreenPos;
+    bool lastInside = false;
+    for (int k = 0; k < entries.size(); ++k) {
+        if (k % CancelCheckInterval == 0 && isCancelled(cancelled))
+            return false;
+
+        const PointPyramid::Entry &entry = entries.at(k);
+        const int i = entry.index;
+        QPointF currentScreenPos = map(xs, ys, i);
+        const bool inside = drawRect.contains(currentScreenPos);
+
+        if (inside) {
+            QColor color = (flags[i] & PointStore::NormalAlt) ?m_scene.normalAltColor : m_scene.abnormalAltColor;
+            painter.setPen(QPen(color, 1));
+            painter.setBrush(QBrush(color));
+            painter.drawEllipse(currentScreenPos, radius, radius);
+        }
+        if (entry.joined && (inside || lastInside)) {
+            painter.setPen(QPen(m_scene.lineSegmentColor, 1));
+            painter.setBrush(QBrush(m_scene.lineSegmentColor));
+            painter.drawLine(currentScreenPos, lastScreenPos);
+        }
+        lastScreenPos = currentScreenPos;
+        lastInside = inside;
+    }
+    return true;
+}
+
+QImage PointRenderer::renderTile(const PointSelection &selection, const QRectF &rect,
+                                 const QAtomicInt *cancelled) const
+{
+    QImage image(rect.size().toSize(), QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.translate(-rect.topLeft());
+    const bool finished = draw(painter, selection, rect, cancelled);
+    painter.end();
+    return finished ? image : QImage();
+}
+
+void TileRenderTask::run()
+{
+    if (isCancelled(m_cancelled.data()))
+        return;
+    const QImage image = PointRenderer(m_scene).renderTile(m_selection, m_rect, m_cancelled.data());
+    if (!image.isNull())
+        m_done(image);
+}
@@ -0,0 +1,88 @@
+#ifndef TILERENDERER_H
+#define TILERENDERER_H
+
+#include <QAtomicInt>
+#include <QColor>
+#include <QImage>
+#include <QPainter>
+#include <QRectF>
+#include <QRunnable>
+#include <QSharedPointer>
+#include <functional>
+#include "datastructures.h"
+#include "pointpyramid.h"
+
+// 绘制点所需的数据和参数的快照，可交给工作线程使用
+// 各列为隐式共享的容器，取快照不复制数据；界面线程之后修改数据时由修改方分离出新副本，
+// 快照保持取快照时的内容
+struct PointScene {
+    PointStore points;          // 点号、线号编码、标志和可见性
+    QVector<float> localX;      // 局部坐标（DataPointData::localX()）
+    QVector<float> localY;
+    double scale;               // 局部坐标到屏幕坐标：(originX + x * scale, originY - y * scale)
+    double originX;
+    double originY;
+    QColor normalAltColor;
+    QColor abnormalAltColor;
+    QColor lineSegmentColor;
+    double pointRadius;
+
+    PointScene() : scale(1), originX(0), originY(0), pointRadius(2) {}
+};
+
+// 一块范围内要画的点：抽稀后的一级，或按网格取出的下标段（完整绘制）
+struct PointSelection {
+    bool thinned;
+    QVector<PointPyramid::Entry> entries;
+    QVector<SpatialGrid::Range> ranges;
+
+    PointSelection() : thinned(false) {}
+};
+
+// 按快照绘制点，cancelled置位后尽快返回false
+class PointRenderer
+{
+public:
+    explicit PointRenderer(const PointScene &scene) : m_scene(scene) {}
+
+    // 绘制屏幕范围screenRect内选中的点
+    bool draw(QPainter &painter, const PointSelection &selection, const QRectF &screenRect,
+              const QAtomicInt *cancelled = nullptr) const;
+    // 绘制[first, end)中的点，并与first之前的一点连线
+    bool drawRange(QPainter &painter, int first, int end, const QAtomicInt *cancelled = nullptr) const;
+    // 绘制抽稀后的一级中落在screenRect内的点，以及一端在其中的连线
+    bool drawEntries(QPainter &painter, const QVector<PointPyramid::Entry> &entries,
+                     const QRectF &screenRect, const QAtomicInt *cancelled = nullptr) const;
+
+    // 把屏幕范围rect画成一块图像，被取消时返回空图像
+    QImage renderTile(const PointSelection &selection, const QRectF &rect,
+                      const QAtomicInt *cancelled = nullptr) const;
+
+private:
+    QPointF map(const float *xs, const float *ys, int i) const
+    {
+        return QPointF(m_scene.originX + xs[i] * m_scene.scale, m_scene.originY - ys[i] * m_scene.scale);
+    }
+
+    const PointScene &m_scene;
+};
+
+// 在线程池中绘制一块图块，未被取消时把结果交给done（在工作线程中调用）
+class TileRenderTask : public QRunnable
+{
+public:
+    TileRenderTask(const PointScene &scene, const PointSelection &selection, const QRectF &rect,
+                   const QSharedPointer<QAtomicInt> &cancelled, const std::function<void(const QImage &)> &done)
+        : m_scene(scene), m_selection(selection), m_rect(rect), m_cancelled(cancelled), m_done(done) {}
+
+    void run() override;
+
+private:
+    PointScene m_scene;
+    PointSelection m_selection;
+    QRectF m_rect;
+    QSharedPointer<QAtomicInt> m_cancelled;
+    std::function<void(const QImage &)> m_done;
+};
+
+#endif // TILERENDERER_H
@@ -0,0 +1,58 @@
+#include "zonemap.h"
+#include "pointstore.h"
+
+void ZoneMap::clear()
+{
+    m_zones.clear();
+    m_size = 0;
+}
+
+void ZoneMap::append(const PointStore &points, int first)
+{
+    m_size = points.size();
+    if (first >= m_size)
+        return;
+
+    const int oldBlocks = m_zones.size();
+    m_zones.resize((m_size + BlockSize - 1) / BlockSize);
+    for (int b = first / BlockSize; b < m_zones.size(); ++b) {
+        // 原有的末尾一块只并入新点，新块从块首开始
+        update(points, b, b < oldBlocks ? qMax(first, blockBegin(b)) : blockBegin(b));
+    }
+}
+
+void ZoneMap::truncate(const PointStore &points)
+{
+    m_size = points.size();
+    m_zones.resize((m_size + BlockSize - 1) / BlockSize);
+    if (m_size % BlockSize != 0)
+        update(points, m_zones.size() - 1, blockBegin(m_zones.size() - 1));
+}
+
+void ZoneMap::update(const PointStore &points, int b, int first)
+{
+    const int *fns = points.fnData();
+    const double *alts = points.altData();
+    const double *xs = points.xData();
+    const double *ys = points.yData();
+
+    Zone &zone = m_zones[b];
+    if (first == blockBegin(b)) {
+        zone.minFn = zone.maxFn = fns[first];
+        zone.minAlt = zone.maxAlt = alts[first];
+        zone.minX = zone.maxX = xs[first];
+        zone.minY = zone.maxY = ys[first];
+    }
+
+    const int end = blockEnd(b);
+    for (int i = first; i < end; ++i) {
+        zone.minFn = qMin(zone.minFn, fns[i]);
+        zone.maxFn = qMax(zone.maxFn, fns[i]);
+        zone.minAlt = qMin(zone.minAlt, alts[i]);
+        zone.maxAlt = qMax(zone.maxAlt, alts[i]);
+        zone.minX = qMin(zone.minX, xs[i]);
+        zone.maxX = qMax(zone.maxX, xs[i]);
+        zone.minY = qMin(zone.minY, ys[i]);
+        zone.maxY = qMax(zone.maxY, ys[i]);
+    }
+}
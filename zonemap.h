@@ -0,0 +1,60 @@
+#ifndef ZONEMAP_H
+#define ZONEMAP_H
+
+#include <QRectF>
+#include <QVector>
+
+class PointStore;
+
+// 分块摘要：每BlockSize个点一块，记录块内点号、高度、X、Y的最小最大值
+// 点号裁剪、高度阈值、选区外接矩形等范围条件先按块判断，整块不可能满足时跳过
+// 点的这几列只在追加和去掉末尾点时改变，摘要随之更新
+class ZoneMap
+{
+public:
+    enum { BlockSize = 1024 };
+
+    struct Zone {
+        int minFn;
+        int maxFn;
+        double minAlt;
+        double maxAlt;
+        double minX;
+        double maxX;
+        double minY;
+        double maxY;
+
+        // 高度范围与[low, high]是否有交集
+        bool overlapsAlt(double low, double high) const { return maxAlt >= low && minAlt <= high; }
+        // 块内各点的外接矩形与rect是否有交集，含边界
+        // 块内点的X或Y相同时（如南北、东西向的线）外接矩形宽或高为0，不能用QRectF::intersects
+        bool overlaps(const QRectF &rect) const
+        {
+            return maxX >= rect.left() && minX <= rect.right()
+                    && maxY >= rect.top() && minY <= rect.bottom();
+        }
+    };
+
+    ZoneMap() : m_size(0) {}
+
+    void clear();
+    // [first, points.size())的点已追加，更新末尾一块并为新点建块
+    void append(const PointStore &points, int first);
+    // 去掉末尾的点后调用，重算末尾一块
+    void truncate(const PointStore &points);
+
+    int blockCount() const { return m_zones.size(); }
+    const Zone &zone(int b) const { return m_zones.at(b); }
+    // 块b的点下标范围[blockBegin, blockEnd)
+    int blockBegin(int b) const { return b * BlockSize; }
+    int blockEnd(int b) const { return qMin((b + 1) * int(BlockSize), m_size); }
+
+private:
+    // 从first起把块b中的点并入摘要，first为块首时重新开始
+    void update(const PointStore &points, int b, int first);
+
+    QVector<Zone> m_zones;
+    int m_size;
+};
+
+#endif // ZONEMAP_H